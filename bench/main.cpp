@@ -0,0 +1,1144 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <malloc.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <atomic>
+#include <set>
+#include "Tree.hpp"
+#include "TreeCompact.hpp"
+#include "TreeSearch.hpp"
+#include "TreeFrozen.hpp"
+#include "TreePersistent.hpp"
+#include "TreeIntern.hpp"
+#include "TreeExpression.hpp"
+#include "TreeParallel.hpp"
+#include "TreeDump.hpp"
+#include "TreeWalk.hpp"
+
+static const size_t DEFAULT_NODES = 10000000;
+static const size_t MAX_SIZES     = 16;
+static const char*  CSV_HEADER    = "operation,type,shape,nodes,batch,ns_per_node,seconds,"
+                                    "bytes_per_node,allocations,peak_rss_kb";
+
+/**
+ * @brief Trees the operations are timed on: balanced and skewed ones are built
+ * bottom-up, random and expression ones are linked top-down, keys go to search trees
+ */
+enum TreeShape
+{
+    SHAPE_BALANCED,
+    SHAPE_SKEWED,
+    SHAPE_RANDOM,
+    SHAPE_EXPRESSION,
+    SHAPE_RANDOM_KEYS,
+    SHAPE_SORTED_KEYS,
+};
+
+static const char* SHAPE_NAMES[] = { "balanced", "skewed", "randtree", "expr", "random", "sorted" };
+
+// every workload starts from the same seed, so runs are repeatable
+static const uint64_t RANDOM_SEED = 88172645463325252ull;
+
+static bool CSV_OUTPUT = false;
+
+/** @struct BenchMark
+ * @brief Clock and allocation counters when a timed operation starts
+ *
+ * @var BenchMark::heapBytes - bytes the tree code holds on the heap
+ */
+struct BenchMark
+{
+    double    ns;
+    size_t    allocations;
+    ptrdiff_t heapBytes;
+};
+
+// tree_bench is linked with --wrap, so every allocation of the tree code goes through here
+extern "C"
+{
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* memory, size_t size);
+void* __real_aligned_alloc(size_t alignment, size_t size);
+void  __real_free(void* memory);
+
+void* __wrap_malloc(size_t size);
+void* __wrap_calloc(size_t count, size_t size);
+void* __wrap_realloc(void* memory, size_t size);
+void* __wrap_aligned_alloc(size_t alignment, size_t size);
+void  __wrap_free(void* memory);
+}
+
+static std::atomic<size_t>    BENCH_ALLOCATIONS = {};
+static std::atomic<ptrdiff_t> BENCH_HEAP_BYTES  = {};
+
+static void* _counted(void* memory)
+{
+    if (memory)
+    {
+        BENCH_ALLOCATIONS.fetch_add(1, std::memory_order_relaxed);
+        BENCH_HEAP_BYTES.fetch_add((ptrdiff_t)malloc_usable_size(memory), std::memory_order_relaxed);
+    }
+
+    return memory;
+}
+
+void* __wrap_malloc(size_t size)
+{
+    return _counted(__real_malloc(size));
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+    return _counted(__real_calloc(count, size));
+}
+
+void* __wrap_aligned_alloc(size_t alignment, size_t size)
+{
+    return _counted(__real_aligned_alloc(alignment, size));
+}
+
+void* __wrap_realloc(void* memory, size_t size)
+{
+    ptrdiff_t oldBytes  = (ptrdiff_t)malloc_usable_size(memory);
+    void*     newMemory = __real_realloc(memory, size);
+
+    // realloc to 0 bytes frees the memory
+    if (newMemory || size == 0)
+        BENCH_HEAP_BYTES.fetch_sub(oldBytes, std::memory_order_relaxed);
+
+    return _counted(newMemory);
+}
+
+void __wrap_free(void* memory)
+{
+    BENCH_HEAP_BYTES.fetch_sub((ptrdiff_t)malloc_usable_size(memory), std::memory_order_relaxed);
+    __real_free(memory);
+}
+
+static double _nowNs()
+{
+    timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double)time.tv_sec * 1e9 + (double)time.tv_nsec;
+}
+
+static BenchMark _mark()
+{
+    BenchMark mark = {};
+
+    mark.allocations = BENCH_ALLOCATIONS.load(std::memory_order_relaxed);
+    mark.heapBytes   = BENCH_HEAP_BYTES.load(std::memory_order_relaxed);
+    mark.ns          = _nowNs();
+
+    return mark;
+}
+
+static size_t _peakRssKb()
+{
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+
+    return (size_t)usage.ru_maxrss;
+}
+
+/**
+ * @brief xorshift64, the workloads do not depend on the C library
+ */
+static uint64_t _nextRandom(uint64_t* state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+/**
+ * @brief Prints a line for the operation which started at start, bytes are the
+ * change of the heap the tree code holds, a negative one means it was freed
+ */
+static void _reportLine(const char* operation, const char* type, const char* shape, size_t nodes, size_t batch,
+                        BenchMark start)
+{
+    double    elapsedNs   = _nowNs() - start.ns;
+    size_t    allocations = BENCH_ALLOCATIONS.load(std::memory_order_relaxed) - start.allocations;
+    ptrdiff_t heapBytes   = BENCH_HEAP_BYTES.load(std::memory_order_relaxed)  - start.heapBytes;
+    double    perNode     = (double)heapBytes / (double)nodes;
+
+    if (CSV_OUTPUT)
+    {
+        printf("%s,%s,%s,%zu,%zu,%.3f,%.6f,%.2f,%zu,%zu\n", operation, type, shape, nodes, batch,
+               elapsedNs / (double)nodes, elapsedNs / 1e9, perNode, allocations, _peakRssKb());
+        return;
+    }
+
+    if (batch)
+        printf("%-8s %-6s batch %8zu %10zu keys %8.2f Mq/s",
+               operation, type, batch, nodes, (double)nodes / elapsedNs * 1e3);
+    else
+        printf("%-8s %-6s %-8s %10zu nodes %8.2f ns/node %8.3f s",
+               operation, type, shape, nodes, elapsedNs / (double)nodes, elapsedNs / 1e9);
+
+    printf(" %8.1f B/node %9zu allocs %7zu MB peak\n", perNode, allocations, _peakRssKb() / 1024);
+}
+
+template <typename T>
+static void _report(const char* operation, TreeShape shape, size_t nodes, BenchMark start)
+{
+    _reportLine(operation, TreeElementTraits<T>::NAME, SHAPE_NAMES[shape], nodes, 0, start);
+}
+
+template <typename T>
+static void _reportBatch(const char* operation, size_t batch, size_t queries, BenchMark start)
+{
+    _reportLine(operation, TreeElementTraits<T>::NAME, "batch", queries, batch, start);
+}
+
+template <typename T>
+static BasicTreeNodeResult<T> _linkTree(TreeShape shape, size_t nodes, BasicTreeNodePool<T>* pool);
+
+/**
+ * @brief Builds a complete tree in heap order or a left-going list, bottom-up,
+ * so no ancestor has to be updated, other shapes are linked by @ref _linkTree
+ */
+template <typename T>
+static BasicTreeNodeResult<T> _buildTree(TreeShape shape, size_t nodes, BasicTreeNodePool<T>* pool)
+{
+    typedef BasicTreeNode<T> Node;
+
+    if (shape == SHAPE_RANDOM || shape == SHAPE_EXPRESSION)
+        return _linkTree(shape, nodes, pool);
+
+    if (shape == SHAPE_SKEWED)
+    {
+        Node* top = nullptr;
+        for (size_t i = nodes; i > 0; i--)
+        {
+            BasicTreeNodeResult<T> nodeRes = Node::New((T)i, top, nullptr, pool);
+            RETURN_RESULT(nodeRes);
+            top = nodeRes.value;
+        }
+        return { top, Error() };
+    }
+
+    Node** heap = (Node**)calloc(nodes, sizeof(*heap));
+    if (!heap)
+        return { nullptr, CREATE_ERROR(ERROR_NO_MEMORY) };
+
+    for (size_t i = nodes; i > 0; i--)
+    {
+        size_t index = i - 1;
+        Node*  left  = 2 * index + 1 < nodes ? heap[2 * index + 1] : nullptr;
+        Node*  right = 2 * index + 2 < nodes ? heap[2 * index + 2] : nullptr;
+
+        BasicTreeNodeResult<T> nodeRes = Node::New((T)index, left, right, pool);
+        if (nodeRes.error)
+        {
+            free(heap);
+            return nodeRes;
+        }
+        heap[index] = nodeRes.value;
+    }
+
+    Node* root = heap[0];
+    free(heap);
+
+    return { root, Error() };
+}
+
+/**
+ * @brief Links a tree of random shape top-down through SetLeft and SetRight
+ *
+ * A random tree splits the nodes under a node at a random point. An expression
+ * tree looks like operators over operands: inner nodes hold operator codes 0-3
+ * and have two children, leaves hold operands, only an even sized tree has a
+ * unary root.
+ */
+template <typename T>
+static BasicTreeNodeResult<T> _linkTree(TreeShape shape, size_t nodes, BasicTreeNodePool<T>* pool)
+{
+    typedef BasicTreeNode<T> Node;
+
+    static const size_t OPERATORS = 4;
+    static const size_t OPERANDS  = 100;
+
+    /** @struct Pending
+     * @brief Node whose subtree of nodes nodes is not linked yet
+     */
+    struct Pending
+    {
+        Node*  node;
+        size_t nodes;
+    };
+
+    if (nodes == 0)
+        return { nullptr, CREATE_ERROR(ERROR_BAD_SIZE) };
+
+    uint64_t random = RANDOM_SEED;
+
+    BasicTreeNodeResult<T> rootRes = Node::New((T)0, nullptr, nullptr, pool);
+    RETURN_RESULT(rootRes);
+
+    // the smaller subtree is linked first, so the bigger ones waiting are at least twice as big each time
+    Pending stack[2 * sizeof(size_t) * 8 + 2] = {};
+    size_t  stackSize = 0;
+    stack[stackSize++] = { rootRes.value, nodes };
+
+    Error error = Error();
+    while (stackSize && !error)
+    {
+        Pending top   = stack[--stackSize];
+        size_t  below = top.nodes - 1;
+        size_t  left  = 0;
+
+        if (shape == SHAPE_RANDOM)
+        {
+            top.node->value = (T)top.nodes;
+            left = _nextRandom(&random) % top.nodes;
+        }
+        else if (below == 0)
+            top.node->value = (T)(_nextRandom(&random) % OPERANDS);
+        else
+        {
+            top.node->value = (T)(_nextRandom(&random) % OPERATORS);
+            // subtrees of an expression have an odd number of nodes
+            left = below % 2 ? below : 2 * (_nextRandom(&random) % (below / 2)) + 1;
+        }
+
+        size_t sizes[2] = { left, below - left };
+        Node*  children[2] = {};
+
+        for (size_t side = 0; side < 2 && !error; side++)
+        {
+            if (!sizes[side])
+                continue;
+
+            BasicTreeNodeResult<T> childRes = Node::New((T)0, nullptr, nullptr, pool);
+            error = childRes.error;
+            if (!error)
+                error = side == 0 ? top.node->SetLeft(childRes.value) : top.node->SetRight(childRes.value);
+            children[side] = childRes.value;
+        }
+
+        size_t bigger = sizes[0] < sizes[1];
+        for (size_t side = 0; side < 2 && !error; side++)
+        {
+            size_t child = side == 0 ? bigger : 1 - bigger;
+            if (children[child])
+                stack[stackSize++] = { children[child], sizes[child] };
+        }
+    }
+
+    if (error)
+    {
+        rootRes.value->Delete();
+        return { nullptr, error };
+    }
+
+    return rootRes;
+}
+
+/**
+ * @brief Builds one tree per thread in the shared pool at the same time
+ */
+template <typename T>
+static Error _benchParallelBuild(TreeShape shape, size_t nodes)
+{
+    typedef BasicTreeNode<T> Node;
+
+    size_t threads = TreeParallelThreads();
+    size_t perTree = nodes / threads;
+    if (perTree == 0)
+        return Error();
+
+    Node** roots = (Node**)calloc(threads, sizeof(*roots));
+    if (!roots)
+        return CREATE_ERROR(ERROR_NO_MEMORY);
+
+    BenchMark start = _mark();
+
+    Error error = TreeParallelFor(threads, threads, [shape, perTree, roots](size_t task, size_t)
+    {
+        BasicTreeNodeResult<T> rootRes = _buildTree(shape, perTree, BasicTreeNodePool<T>::Shared());
+        roots[task] = rootRes.value;
+
+        // the worker threads exit right after, so their caches are given back here
+        Error error = BasicTreeNodePool<T>::ReleaseCache();
+        return rootRes.error ? rootRes.error : error;
+    });
+
+    if (!error)
+        _report<T>("pbuild", shape, perTree * threads, start);
+
+    for (size_t tree = 0; tree < threads; tree++)
+        if (roots[tree])
+            roots[tree]->Delete();
+    free(roots);
+
+    return error;
+}
+
+#ifdef TREE_SUBTREE_SIZES
+/**
+ * @brief Looks up nodes by in-order position and back, visiting positions in a scattered order
+ */
+template <typename T>
+static Error _benchOrderStatistics(BasicTree<T>* tree, TreeShape shape, size_t nodes)
+{
+    static const size_t MAX_QUERIES = 1 << 20;
+    // a prime step visits every position once when nodes does not divide by it
+    static const size_t STEP        = 2654435761;
+
+    // a query walks the depth, a skewed tree would take quadratic time
+    if (shape != SHAPE_BALANCED)
+        return Error();
+
+    size_t queries = nodes < MAX_QUERIES ? nodes : MAX_QUERIES;
+
+    RETURN_ERROR(tree->UpdateSizes().error);
+
+    BenchMark start = _mark();
+    for (size_t query = 0; query < queries; query++)
+    {
+        size_t index = query * STEP % nodes;
+
+        BasicTreeNodeResult<T> nodeRes = tree->Select(index);
+        RETURN_ERROR(nodeRes.error);
+
+        TreeNodeCountResult rankRes = tree->Rank(nodeRes.value);
+        RETURN_ERROR(rankRes.error);
+
+        if (rankRes.value != index)
+            return CREATE_ERROR(ERROR_BAD_TREE);
+    }
+    _report<T>("selrank", shape, queries, start);
+
+    return Error();
+}
+#endif
+
+/**
+ * @brief Snapshots the tree as Tree::Dump does and writes the .dot file, with
+ * record labels and compact ones, without drawing it
+ */
+template <typename T>
+static Error _benchDump(const BasicTree<T>* tree, TreeShape shape, size_t nodes, const char* dotPath)
+{
+    static const char* NAMES[] = { "dumpdot", "dumpcmp" };
+
+    Error error = Error();
+    for (size_t compact = 0; compact < 2 && !error; compact++)
+    {
+        TreeDumpOptions options = {};
+        options.maxDepth = TREE_DUMP_MAX_DEPTH;
+        options.maxNodes = TREE_DUMP_MAX_NODES;
+        options.compact  = compact;
+
+        BenchMark start = _mark();
+
+        TreeDumpJob job = {};
+        job.errorName = "ok";
+
+        int fd = open(dotPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            return CREATE_ERROR(ERROR_BAD_FILE);
+
+        TreeTextWriter writer = {};
+        error = writer.Init(fd);
+
+        if (!error)
+            error = job.Init(tree->root, &options);
+        if (!error)
+            error = job.WriteDot(&writer);
+        if (!error)
+            error = writer.Flush();
+
+        writer.Destructor();
+        close(fd);
+
+        if (!error)
+            _report<T>(NAMES[compact], shape, nodes, start);
+
+        job.Destructor();
+    }
+
+    remove(dotPath);
+
+    return error;
+}
+
+template <typename T>
+static Error _benchShape(TreeShape shape, size_t nodes, const char* printPath)
+{
+    BenchMark start = _mark();
+
+    BasicTreeNodeResult<T> rootRes = _buildTree(shape, nodes, BasicTreeNodePool<T>::Shared());
+    RETURN_ERROR(rootRes.error);
+    _report<T>("build", shape, nodes, start);
+
+    RETURN_ERROR(_benchParallelBuild<T>(shape, nodes));
+
+    BasicTree<T> tree = {};
+    RETURN_ERROR(tree.Init(rootRes.value));
+
+    start = _mark();
+    TreeNodeCountResult countRes = tree.CountNodes();
+    RETURN_ERROR(countRes.error);
+    _report<T>("count", shape, nodes, start);
+
+    if (countRes.value != nodes)
+        return CREATE_ERROR(ERROR_BAD_TREE);
+
+    start = _mark();
+    countRes = tree.CountNodes(0);
+    RETURN_ERROR(countRes.error);
+    _report<T>("pcount", shape, nodes, start);
+
+    #ifdef TREE_SUBTREE_SIZES
+    RETURN_ERROR(_benchOrderStatistics(&tree, shape, nodes));
+    #endif
+
+    BasicCompactTree<T> compact = {};
+    RETURN_ERROR(compact.Init(nodes));
+
+    start = _mark();
+    RETURN_ERROR(compact.FromTree(&tree));
+    _report<T>("compact", shape, nodes, start);
+
+    start = _mark();
+    countRes = compact.CountNodes();
+    RETURN_ERROR(countRes.error);
+    _report<T>("ccount", shape, nodes, start);
+
+    BasicCompactTree<T> compactCopy = {};
+    RETURN_ERROR(compactCopy.Init(nodes));
+
+    start = _mark();
+    RETURN_ERROR(compactCopy.Copy(&compact));
+    _report<T>("ccopy", shape, nodes, start);
+
+    RETURN_ERROR(compactCopy.Destructor());
+    RETURN_ERROR(compact.Destructor());
+
+    start = _mark();
+    BasicTreeNodeResult<T> copyRes = tree.root->Copy();
+    RETURN_ERROR(copyRes.error);
+    _report<T>("copy", shape, nodes, start);
+
+    start = _mark();
+    RETURN_ERROR(copyRes.value->Delete());
+    _report<T>("delete", shape, nodes, start);
+
+    start = _mark();
+    copyRes = tree.root->Copy(BasicTreeNodePool<T>::Shared(), 0);
+    RETURN_ERROR(copyRes.error);
+    _report<T>("pcopy", shape, nodes, start);
+
+    start = _mark();
+    RETURN_ERROR(copyRes.value->Delete(0));
+    _report<T>("pdelete", shape, nodes, start);
+
+    RETURN_ERROR(_benchDump(&tree, shape, nodes, printPath));
+
+    start = _mark();
+    RETURN_ERROR(tree.Print(printPath));
+    _report<T>("print", shape, nodes, start);
+
+    start = _mark();
+    TreeBufferResult bufferRes = tree.PrintToBuffer();
+    RETURN_ERROR(bufferRes.error);
+    _report<T>("printbuf", shape, nodes, start);
+    free(bufferRes.value.data);
+
+    RETURN_ERROR(tree.Destructor());
+
+    start = _mark();
+    RETURN_ERROR(tree.Read(printPath));
+    _report<T>("read", shape, nodes, start);
+
+    start = _mark();
+    RETURN_ERROR(tree.WriteBinary(printPath));
+    _report<T>("writebin", shape, nodes, start);
+
+    RETURN_ERROR(tree.Destructor());
+
+    start = _mark();
+    RETURN_ERROR(tree.ReadBinary(printPath));
+    _report<T>("readbin", shape, nodes, start);
+
+    start = _mark();
+    RETURN_ERROR(tree.Destructor());
+    _report<T>("release", shape, nodes, start);
+
+    remove(printPath);
+
+    return Error();
+}
+
+/**
+ * @brief Inserts, finds and erases keys in a search tree and in std::set, which is
+ * the same red-black tree as std::map without mapped values
+ */
+template <typename T>
+static Error _benchSearch(TreeShape shape, size_t nodes)
+{
+    T* keys = (T*)calloc(nodes, sizeof(*keys));
+    if (!keys)
+        return CREATE_ERROR(ERROR_NO_MEMORY);
+
+    uint64_t random = RANDOM_SEED;
+    for (size_t i = 0; i < nodes; i++)
+        keys[i] = shape == SHAPE_SORTED_KEYS ? (T)i : (T)(_nextRandom(&random) % (4 * nodes));
+
+    BasicSearchTree<T> tree = {};
+    Error error = tree.Init();
+
+    BenchMark start = _mark();
+    for (size_t i = 0; i < nodes && !error; i++)
+        error = tree.Insert(keys[i]).error;
+    if (!error)
+        _report<T>("insert", shape, nodes, start);
+
+    size_t found = 0;
+    start = _mark();
+    for (size_t i = 0; i < nodes && !error; i++)
+        found += tree.Find(keys[i]) != nullptr;
+    if (!error)
+        _report<T>("find", shape, nodes, start);
+
+    start = _mark();
+    for (size_t i = 0; i < nodes && !error; i++)
+        error = tree.Erase(keys[i]).error;
+    if (!error)
+        _report<T>("erase", shape, nodes, start);
+
+    tree.Destructor();
+
+    std::set<T> set;
+
+    start = _mark();
+    for (size_t i = 0; i < nodes && !error; i++)
+        set.insert(keys[i]);
+    if (!error)
+        _report<T>("setins", shape, nodes, start);
+
+    size_t setFound = 0;
+    start = _mark();
+    for (size_t i = 0; i < nodes && !error; i++)
+        setFound += set.find(keys[i]) != set.end();
+    if (!error)
+        _report<T>("setfind", shape, nodes, start);
+
+    start = _mark();
+    for (size_t i = 0; i < nodes && !error; i++)
+        set.erase(keys[i]);
+    if (!error)
+        _report<T>("seterase", shape, nodes, start);
+
+    free(keys);
+
+    if (!error && found != setFound)
+        return CREATE_ERROR(ERROR_BAD_TREE);
+
+    return error;
+}
+
+/**
+ * @brief Loads sorted keys as a balanced tree in one pass, compare with
+ * inserting them one by one into a search tree
+ */
+template <typename T>
+static Error _benchBulkLoad(size_t nodes)
+{
+    T* keys = (T*)calloc(nodes, sizeof(*keys));
+    if (!keys)
+        return CREATE_ERROR(ERROR_NO_MEMORY);
+
+    for (size_t i = 0; i < nodes; i++)
+        keys[i] = (T)i;
+
+    BasicTree<T> tree = {};
+
+    BenchMark start = _mark();
+    Error error = tree.BuildFromSorted(keys, nodes);
+    if (!error)
+    {
+        _report<T>("bulk", SHAPE_SORTED_KEYS, nodes, start);
+        tree.Destructor();
+    }
+
+    if (!error)
+    {
+        start = _mark();
+        error = tree.BuildFromSorted(keys, nodes, 0);
+    }
+    if (!error)
+    {
+        _report<T>("pbulk", SHAPE_SORTED_KEYS, nodes, start);
+        tree.Destructor();
+    }
+
+    free(keys);
+
+    return error;
+}
+
+/**
+ * @brief Looks random keys up in a balanced pointer tree and in its frozen copy,
+ * half of the keys are missing
+ */
+template <typename T>
+static Error _benchFrozen(size_t nodes)
+{
+    typedef BasicTreeNode<T> Node;
+
+    T* keys = (T*)calloc(nodes, sizeof(*keys));
+    if (!keys)
+        return CREATE_ERROR(ERROR_NO_MEMORY);
+
+    for (size_t i = 0; i < nodes; i++)
+        keys[i] = (T)(2 * i);
+
+    BasicTree<T>       tree   = {};
+    BasicFrozenTree<T> frozen = {};
+    frozen.Init();
+
+    Error error = tree.BuildFromSorted(keys, nodes);
+    if (error)
+    {
+        free(keys);
+        return error;
+    }
+
+    uint64_t random = RANDOM_SEED;
+    for (size_t i = 0; i < nodes; i++)
+        keys[i] = (T)(_nextRandom(&random) % (2 * nodes));
+
+    size_t    found = 0;
+    BenchMark start = _mark();
+    for (size_t i = 0; i < nodes; i++)
+    {
+        Node* node = tree.root;
+        while (node && node->value != keys[i])
+            node = keys[i] < node->value ? node->left : node->right;
+        found += node != nullptr;
+    }
+    _report<T>("ptrfind", SHAPE_RANDOM_KEYS, nodes, start);
+
+    start = _mark();
+    error = frozen.Freeze(tree.root);
+    if (!error)
+        _report<T>("freeze", SHAPE_RANDOM_KEYS, nodes, start);
+
+    size_t frozenFound = 0;
+    start = _mark();
+    for (size_t i = 0; i < nodes && !error; i++)
+        frozenFound += frozen.Find(keys[i]) != nullptr;
+    if (!error)
+        _report<T>("frzfind", SHAPE_RANDOM_KEYS, nodes, start);
+
+    tree.Destructor();
+    frozen.Destructor();
+    free(keys);
+
+    if (!error && found != frozenFound)
+        return CREATE_ERROR(ERROR_BAD_TREE);
+
+    return error;
+}
+
+/**
+ * @brief Looks the same random keys up in a frozen tree one by one and in batches
+ * of 1K to 1M keys, half of the keys are missing
+ */
+template <typename T>
+static Error _benchBatch(size_t nodes)
+{
+    static const size_t QUERIES      = 1 << 20;
+    static const size_t MIN_BATCH    = 1 << 10;
+    static const size_t BATCH_FACTOR = 4;
+
+    T*        keys  = (T*)calloc(nodes > QUERIES ? nodes : QUERIES, sizeof(*keys));
+    const T** found = (const T**)calloc(QUERIES, sizeof(*found));
+    if (!keys || !found)
+    {
+        free(keys);
+        free(found);
+        return CREATE_ERROR(ERROR_NO_MEMORY);
+    }
+
+    for (size_t i = 0; i < nodes; i++)
+        keys[i] = (T)(2 * i);
+
+    BasicTree<T>       tree   = {};
+    BasicFrozenTree<T> frozen = {};
+    frozen.Init();
+
+    Error error = tree.BuildFromSorted(keys, nodes);
+    if (!error)
+    {
+        error = frozen.Freeze(tree.root);
+        tree.Destructor();
+    }
+
+    uint64_t random = RANDOM_SEED;
+    for (size_t i = 0; i < QUERIES; i++)
+        keys[i] = (T)(_nextRandom(&random) % (2 * nodes));
+
+    size_t    single = 0;
+    BenchMark start  = _mark();
+    for (size_t i = 0; i < QUERIES && !error; i++)
+        single += frozen.Find(keys[i]) != nullptr;
+    if (!error)
+        _reportBatch<T>("frzfind", 1, QUERIES, start);
+
+    for (size_t batch = MIN_BATCH; batch <= QUERIES && !error; batch *= BATCH_FACTOR)
+    {
+        start = _mark();
+        for (size_t first = 0; first < QUERIES && !error; first += batch)
+            error = frozen.FindBatch(keys + first, batch < QUERIES - first ? batch : QUERIES - first, found + first);
+        if (error)
+            break;
+        _reportBatch<T>("frzbatch", batch, QUERIES, start);
+
+        size_t batched = 0;
+        for (size_t i = 0; i < QUERIES; i++)
+            batched += found[i] != nullptr;
+        if (batched != single)
+            error = CREATE_ERROR(ERROR_BAD_TREE);
+    }
+
+    frozen.Destructor();
+    free(keys);
+    free(found);
+
+    return error;
+}
+
+/**
+ * @brief Snapshots a tree and changes one deep node in the snapshot, persistently
+ * and by copying the whole tree
+ */
+template <typename T>
+static Error _benchPersistent(size_t nodes)
+{
+    static const size_t UPDATES = 1 << 16;
+    static const size_t COPIES  = 4;
+
+    T* keys = (T*)calloc(nodes, sizeof(*keys));
+    if (!keys)
+        return CREATE_ERROR(ERROR_NO_MEMORY);
+
+    for (size_t i = 0; i < nodes; i++)
+        keys[i] = (T)i;
+
+    BasicTree<T>           tree    = {};
+    BasicPersistentTree<T> version = {};
+    version.Init();
+
+    Error error = tree.BuildFromSorted(keys, nodes);
+    free(keys);
+    RETURN_ERROR(error);
+
+    BenchMark start = _mark();
+    error = version.FromTree(&tree);
+    if (!error)
+        _report<T>("pfrom", SHAPE_BALANCED, nodes, start);
+
+    // a path to a node one level above the leaves
+    char   path[64] = "";
+    size_t depth    = 0;
+    while (depth + 1 < sizeof(path) && ((size_t)4 << depth) <= nodes)
+        depth++;
+
+    uint64_t random = RANDOM_SEED;
+    start = _mark();
+    for (size_t update = 0; update < UPDATES && !error; update++)
+    {
+        _nextRandom(&random);
+
+        for (size_t step = 0; step < depth; step++)
+            path[step] = (random >> step) & 1 ? 'R' : 'L';
+
+        BasicPersistentTree<T> snapshot = {};
+        version.Snapshot(&snapshot);
+
+        error = snapshot.Set(path, (T)update);
+
+        version.Destructor();
+        version = snapshot;
+    }
+    if (!error)
+        _report<T>("pupdate", SHAPE_BALANCED, UPDATES, start);
+
+    start = _mark();
+    for (size_t update = 0; update < COPIES && !error; update++)
+    {
+        BasicTreeNodePool<T> pool = {};
+        pool.Init();
+
+        BasicTreeNodeResult<T> copyRes = tree.root->Copy(&pool);
+        error = copyRes.error;
+        if (!error)
+            copyRes.value->value = (T)update;
+
+        pool.Destructor();
+    }
+    if (!error)
+        _report<T>("cupdate", SHAPE_BALANCED, COPIES, start);
+
+    version.Destructor();
+    tree.Destructor();
+
+    return error;
+}
+
+/**
+ * @brief Interns a balanced tree whose values repeat level by level, and saves
+ * and reads the DAG back
+ *
+ * A tree of 2^k - 1 nodes is complete and folds into a DAG with a node per
+ * level. Other sizes leave the subtrees along the cuts of BuildFromSorted
+ * uneven, so they keep more distinct nodes, which the dag line reports.
+ */
+template <typename T>
+static Error _benchIntern(size_t nodes, const char* printPath)
+{
+    T* keys = (T*)calloc(nodes, sizeof(*keys));
+    if (!keys)
+        return CREATE_ERROR(ERROR_NO_MEMORY);
+
+    // in-order position i + 1 of a complete tree has as many trailing zeros as its height
+    for (size_t i = 0; i < nodes; i++)
+        keys[i] = (T)__builtin_ctzll(i + 1);
+
+    BasicTree<T>        tree  = {};
+    BasicInternTable<T> table = {};
+    BasicInternTable<T> read  = {};
+    table.Init();
+    read.Init();
+
+    Error error = tree.BuildFromSorted(keys, nodes);
+    free(keys);
+    RETURN_ERROR(error);
+
+    BenchMark start = _mark();
+    typename BasicInternNode<T>::Result rootRes = table.FromTree(&tree);
+    error = rootRes.error;
+    if (!error)
+        _report<T>("intern", SHAPE_BALANCED, nodes, start);
+
+    start = _mark();
+    if (!error)
+        error = table.WriteBinary(rootRes.value, printPath);
+    if (!error)
+        _report<T>("dagwrite", SHAPE_BALANCED, nodes, start);
+
+    start = _mark();
+    if (!error)
+        error = read.ReadBinary(printPath).error;
+    if (!error)
+        _report<T>("dagread", SHAPE_BALANCED, nodes, start);
+
+    if (!error && !CSV_OUTPUT)
+        printf("%-8s %-6s %-8s %10zu nodes %10zu distinct\n", "dag", TreeElementTraits<T>::NAME,
+               SHAPE_NAMES[SHAPE_BALANCED], nodes, table.count);
+
+    remove(printPath);
+    read.Destructor();
+    table.Destructor();
+    tree.Destructor();
+
+    return error;
+}
+
+/**
+ * @brief Value of the expression under node for one row, one call per node
+ */
+static double _evaluateRecursive(const BasicTreeNode<double>* node, const double* const* columns, size_t row)
+{
+    if (!node->left && !node->right)
+    {
+        size_t column = 0;
+        if (TreeExpressionIsColumn(node->value, &column))
+            return columns[column][row];
+
+        return node->value;
+    }
+
+    if (!node->left || !node->right)
+    {
+        double value = _evaluateRecursive(node->left ? node->left : node->right, columns, row);
+        return node->value == TREE_OPERATOR_SUB ? -value : value;
+    }
+
+    double left  = _evaluateRecursive(node->left,  columns, row);
+    double right = _evaluateRecursive(node->right, columns, row);
+
+    switch ((TreeOperator)(size_t)node->value)
+    {
+        case TREE_OPERATOR_ADD: return left + right;
+        case TREE_OPERATOR_SUB: return left - right;
+        case TREE_OPERATOR_MUL: return left * right;
+        case TREE_OPERATOR_DIV:
+        case TREE_OPERATORS_COUNT:
+        default:                return left / right;
+    }
+}
+
+/**
+ * @brief Evaluates an expression tree over columns of random rows, walking the
+ * nodes once per row and running the compiled code over blocks of rows
+ *
+ * Evaluations are reported per node and row. Trees get fewer rows as they grow,
+ * so every size does about the same work.
+ */
+static Error _benchExpression(size_t nodes)
+{
+    static const size_t COLUMNS  = 8;
+    static const size_t WORK     = 1 << 26;
+    static const size_t MAX_ROWS = 1 << 20;
+
+    // an odd sized expression has no unary nodes
+    size_t size = nodes % 2 ? nodes : nodes - 1;
+    if (size == 0)
+        return Error();
+
+    size_t rows = WORK / size;
+    if (rows == 0)
+        rows = 1;
+    if (rows > MAX_ROWS)
+        rows = MAX_ROWS;
+
+    BasicTreeNodeResult<double> rootRes = _linkTree(SHAPE_EXPRESSION, size, BasicTreeNodePool<double>::Shared());
+    RETURN_ERROR(rootRes.error);
+
+    BasicTree<double> tree = {};
+    RETURN_ERROR(tree.Init(rootRes.value));
+
+    // operands below COLUMNS read those columns, the others stay constants
+    RETURN_ERROR(TreePreOrder(tree.root, [](BasicTreeNode<double>* node, size_t)
+    {
+        if (!node->left && !node->right && node->value < COLUMNS)
+            node->value = TreeExpressionColumn((size_t)node->value);
+        return Error();
+    }));
+
+    double*  values  = (double*)calloc(COLUMNS * rows, sizeof(*values));
+    double*  naive   = (double*)calloc(rows, sizeof(*naive));
+    double*  results = (double*)calloc(rows, sizeof(*results));
+    uint64_t random  = RANDOM_SEED;
+
+    const double* columns[COLUMNS] = {};
+    for (size_t column = 0; column < COLUMNS && values; column++)
+        columns[column] = values + column * rows;
+
+    Error error = values && naive && results ? Error() : CREATE_ERROR(ERROR_NO_MEMORY);
+
+    for (size_t value = 0; value < COLUMNS * rows && !error; value++)
+        values[value] = (double)(_nextRandom(&random) % 1000) / 10 + 1;
+
+    BenchMark start = _mark();
+    for (size_t row = 0; row < rows && !error; row++)
+        naive[row] = _evaluateRecursive(tree.root, columns, row);
+    if (!error)
+        _report<double>("exprrec", SHAPE_EXPRESSION, size * rows, start);
+
+    TreeExpression expression = {};
+    expression.Init();
+
+    start = _mark();
+    if (!error)
+        error = expression.Compile(&tree, COLUMNS);
+    if (!error)
+        _report<double>("exprcomp", SHAPE_EXPRESSION, size, start);
+
+    start = _mark();
+    if (!error)
+        error = expression.Evaluate(columns, rows, results);
+    if (!error)
+        _report<double>("expreval", SHAPE_EXPRESSION, size * rows, start);
+
+    // the same operations in the same order, so the results are the same bit for bit, NaNs aside
+    for (size_t row = 0; row < rows && !error; row++)
+    {
+        if (naive[row] != results[row] && (naive[row] == naive[row] || results[row] == results[row]))
+            error = CREATE_ERROR(ERROR_BAD_TREE);
+    }
+
+    expression.Destructor();
+    free(values);
+    free(naive);
+    free(results);
+    tree.Destructor();
+
+    return error;
+}
+
+/**
+ * @brief Runs every benchmark on trees of nodes nodes
+ */
+static Error _benchAll(size_t nodes, const char* printPath)
+{
+    static const TreeShape SHAPES[] = { SHAPE_BALANCED, SHAPE_SKEWED, SHAPE_RANDOM, SHAPE_EXPRESSION };
+
+    for (size_t shape = 0; shape < sizeof(SHAPES) / sizeof(*SHAPES); shape++)
+        RETURN_ERROR(_benchShape<TreeElement_t>(SHAPES[shape], nodes, printPath));
+
+    RETURN_ERROR(_benchShape<int32_t>(SHAPE_BALANCED, nodes, printPath));
+
+    RETURN_ERROR(_benchSearch<TreeElement_t>(SHAPE_RANDOM_KEYS, nodes));
+    RETURN_ERROR(_benchSearch<TreeElement_t>(SHAPE_SORTED_KEYS, nodes));
+
+    RETURN_ERROR(_benchBulkLoad<TreeElement_t>(nodes));
+    RETURN_ERROR(_benchFrozen<TreeElement_t>(nodes));
+    RETURN_ERROR(_benchBatch<TreeElement_t>(nodes));
+    RETURN_ERROR(_benchPersistent<TreeElement_t>(nodes));
+    RETURN_ERROR(_benchIntern<TreeElement_t>(nodes, printPath));
+    RETURN_ERROR(_benchExpression(nodes));
+
+    return Error();
+}
+
+int main(int argc, const char* argv[])
+{
+    size_t      sizes[MAX_SIZES] = { DEFAULT_NODES };
+    size_t      sizesCount       = 1;
+    const char* printPath        = "bench_tree.txt";
+    size_t      positional       = 0;
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "--csv") == 0)
+            CSV_OUTPUT = true;
+        else if (positional++ == 0)
+        {
+            // sizes are separated by commas: 1000,1000000
+            const char* size = argv[arg];
+            for (sizesCount = 0; sizesCount < MAX_SIZES && *size; sizesCount++)
+            {
+                char* end = nullptr;
+                sizes[sizesCount] = strtoull(size, &end, 10);
+                size = *end == ',' ? end + 1 : end;
+            }
+        }
+        else
+            printPath = argv[arg];
+    }
+
+    if (CSV_OUTPUT)
+        printf("%s\n", CSV_HEADER);
+
+    for (size_t size = 0; size < sizesCount; size++)
+    {
+        Error error = _benchAll(sizes[size], printPath);
+        SoftAssert(!error, error);
+    }
+
+    return 0;
+}
@@ -5,41 +5,72 @@
 #include "String.hpp"
 #include "Utils.hpp"
 #include "TreeSettings.hpp"
+#include "TreeElement.hpp"
+#include "TreeNodePool.hpp"
+#include "TreeText.hpp"
+#include "TreeStats.hpp"
 
-struct TreeNodeResult;
-/** @struct TreeNode
+#ifndef NDEBUG
+template <typename Node>
+struct TreeTouchedLog;
+#endif
+
+/** @struct BasicTreeNode
  * @brief A binary tree node containing value and ptrs to children
  * 
- * @var TreeNode::value - TreeElemen_t value
- * @var TreeNode::left - TreeNode* left
- * @var TreeNode::right - TreeNode* right
- * @var TreeNode::parent - TreeNode* parent
- * @var TreeNode::id - size_t id - unique id of a node, used for dumping
- * @var TreeNode::nodeCount - number of all nodes going from the current one
+ * @tparam T - element type
+ * @tparam Traits - @ref TreeElementTraits of T
+ * 
+ * @var BasicTreeNode::left - left child
+ * @var BasicTreeNode::right - right child
+ * @var BasicTreeNode::parent - parent
+ * @var BasicTreeNode::value - T value
+ * @var BasicTreeNode::id - unique id of a node, used for dumping
+ * @var BasicTreeNode::red - color of the node in a @ref BasicSearchTree, takes the top bit of id
+ * @var BasicTreeNode::nodeCount - number of all nodes going from the current one,
+ * @ref TREE_SIZE_STALE if it has to be recounted, only with @ref TREE_SUBTREE_SIZES
+ * @var BasicTreeNode::touchedIndex - 1 + position in the log of nodes touched since
+ * the last incremental verification, 0 if not there
+ * @var BasicTreeNode::touchedLog - log of the tree checked incrementally the node is in,
+ * nullptr if none
 */
-struct TreeNode
+template <typename T, typename Traits>
+struct BasicTreeNode
 {
-    TreeElement_t value;
-    TreeNode*     left;
-    TreeNode*     right;
-    TreeNode*     parent;
+    typedef T                              Element;
+    typedef Traits                         ElementTraits;
+    typedef BasicTreeNodeResult<T, Traits> Result;
+    typedef BasicTreeNodePool<T, Traits>   Pool;
 
-    size_t id;
+    BasicTreeNode* left;
+    BasicTreeNode* right;
+    BasicTreeNode* parent;
 
-    #ifndef NDEBUG
+    T                   value;
+    typename Traits::Id id  : sizeof(typename Traits::Id) * 8 - 1;
+    typename Traits::Id red : 1;
+
+    #ifdef TREE_SUBTREE_SIZES
     size_t nodeCount;
     #endif
 
+    #ifndef NDEBUG
+    size_t                         touchedIndex;
+    TreeTouchedLog<BasicTreeNode>* touchedLog;
+    #endif
+
     /**
      * @brief Returns a new node result
      * 
      * @param [in] value - value
      * @param [in] left - left child
      * @param [in] right - right child
-     * @return TreeNodeResult - new node
+     * @param [in] pool - where to allocate the node, @ref BasicTreeNodePool::Shared by default
+     * @return Result - new node
      */
-    static TreeNodeResult New(TreeElement_t value, TreeNode* left, TreeNode* right);
-    static TreeNodeResult New(TreeElement_t value);
+    static Result New(T value, BasicTreeNode* left, BasicTreeNode* right, Pool* pool);
+    static Result New(T value, BasicTreeNode* left, BasicTreeNode* right);
+    static Result New(T value);
 
     /**
      * @brief Deletes a node
@@ -48,12 +79,40 @@ struct TreeNode
      */
     Error Delete();
 
+    /**
+     * @brief Deletes a node freeing its subtrees on several threads
+     * 
+     * Subtrees smaller than @ref TREE_PARALLEL_CUTOFF are deleted on one thread.
+     * 
+     * @attention The pools of the nodes must not be used by other threads meanwhile
+     * 
+     * @param [in] threads - how many threads to use, 0 for one per core
+     * @return Error
+     */
+    Error Delete(size_t threads);
+
     /**
      * @brief Copies the node and returns the copy
      * 
-     * @return TreeNodeResult the copy
+     * @param [in] pool - where to allocate the copy, @ref BasicTreeNodePool::Shared by default
+     * @return Result the copy
+     */
+    Result Copy(Pool* pool);
+    Result Copy();
+
+    /**
+     * @brief Copies the node copying its subtrees on several threads
+     * 
+     * Each thread fills its own pool, the pools are merged into pool at the end.
+     * Subtrees smaller than @ref TREE_PARALLEL_CUTOFF are copied on one thread.
+     * 
+     * @attention pool must not be used by other threads meanwhile
+     * 
+     * @param [in] pool - where the copy ends up
+     * @param [in] threads - how many threads to use, 0 for one per core
+     * @return Result the copy
      */
-    TreeNodeResult Copy();
+    Result Copy(Pool* pool, size_t threads);
 
     /**
      * @brief Sets the left node.
@@ -61,7 +120,7 @@ struct TreeNode
      * @param [in] left - the left node.
      * @return Error
      */
-    Error SetLeft(TreeNode* left);
+    Error SetLeft(BasicTreeNode* left);
     
     /**
      * @brief Sets the right node.
@@ -69,12 +128,23 @@ struct TreeNode
      * @param [in] right - the right node.
      * @return Error
      */
-    Error SetRight(TreeNode* right);
+    Error SetRight(BasicTreeNode* right);
+
+    #ifdef TREE_SUBTREE_SIZES
+    /**
+     * @brief Marks the sizes of the node and its ancestors stale, for links changed by hand
+     * 
+     * @return Error - @ref ERROR_TREE_LOOP if a parent link is broken on the way up
+     */
+    Error InvalidateSizes();
+    #endif
 };
-struct TreeNodeResult
+
+template <typename T, typename Traits>
+struct BasicTreeNodeResult
 {
-    TreeNode* value;
-    Error     error;
+    BasicTreeNode<T, Traits>* value;
+    Error                     error;
 };
 
 /** @struct TreeNodeCountResult
@@ -89,19 +159,54 @@ struct TreeNodeCountResult
     Error  error;
 };
 
-/** @struct Tree
+/** @struct TreeDumpOptions
+ * @brief What part of a tree @ref BasicTree::Dump shows and how
+ *
+ * Nodes are taken breadth first, so the budget goes to the nodes nearest to the
+ * root. A subtree which is too deep or over the budget is drawn as one summary
+ * node with its size and its smallest and largest values.
+ *
+ * @var TreeDumpOptions::maxDepth - deeper subtrees are collapsed
+ * @var TreeDumpOptions::maxNodes - how many nodes are drawn as they are, summaries come on top
+ * @var TreeDumpOptions::compact - plain one-line labels instead of records with ids and sizes
+ */
+struct TreeDumpOptions
+{
+    size_t maxDepth;
+    size_t maxNodes;
+    bool   compact;
+};
+
+/** @struct BasicTree
  * @brief Represents a binary tree
  * 
- * @var Tree::root - root of the tree
- * @var Tree::size - number of nodes in the tree
+ * The tree is compiled for the element types in @ref TREE_ELEMENT_TYPES,
+ * @ref Tree is the one of @ref TreeElement_t.
+ * 
+ * Const methods do not write to the nodes: walks check parent links to find loops
+ * instead of marking nodes. So several threads may count, print, dump and copy
+ * (into pools of their own) the same tree at once, as long as none of them changes it.
+ * 
+ * @tparam T - element type
+ * @tparam Traits - @ref TreeElementTraits of T
+ * 
+ * @var BasicTree::root - root of the tree
+ * @var BasicTree::pool - pool owned by the tree, nullptr if nodes are in @ref BasicTreeNodePool::Shared
+ * @var BasicTree::verifyPolicy - how much @ref BasicTree::Verify checks, reset by Init,
+ * kept when the tree is read or built into again
+ * @var BasicTree::maxSize - most nodes a debug @ref BasicTree::Verify accepts, 0 for no limit,
+ * reset by Init like verifyPolicy
  */
-struct Tree
+template <typename T, typename Traits = TreeElementTraits<T>>
+struct BasicTree
 {
-    TreeNode* root;
+    typedef BasicTreeNode<T, Traits>     Node;
+    typedef BasicTreeNodePool<T, Traits> Pool;
 
-    #ifndef NDEBUG
-    size_t* size;
-    #endif
+    Node*            root;
+    Pool*            pool;
+    TreeVerifyPolicy verifyPolicy;
+    size_t           maxSize;
 
     /**
      * @brief Initializes a tree with a root node
@@ -109,7 +214,7 @@ struct Tree
      * @param [in] root
      * @return Error
      */
-    Error Init(TreeNode* root);
+    Error Init(Node* root);
 
     /**
      * @brief Initializes a tree with an empty root
@@ -118,6 +223,16 @@ struct Tree
      */
     Error Init();
 
+    /**
+     * @brief Initializes a tree with an empty root allocated in the tree's own pool
+     * 
+     * @attention Every node added to the tree must be allocated in @ref BasicTree::pool,
+     * as @ref BasicTree::Destructor releases the pool slab by slab without visiting nodes
+     * 
+     * @return Error
+     */
+    Error InitPooled();
+
     /**
      * @brief Destroys the tree
      * 
@@ -126,50 +241,172 @@ struct Tree
     Error Destructor();
 
     /**
-     * @brief Checks the tree's integrity
+     * @brief Checks the tree's integrity as much as @ref BasicTree::verifyPolicy says
+     * 
+     * A tree of more than @ref BasicTree::maxSize nodes is @ref ERROR_BAD_SIZE. The size
+     * comes from the subtree sizes, and the stale part is counted without being written, so
+     * call @ref BasicTree::UpdateSizes after a batch of changes to keep the limit O(1).
+     * 
+     * @attention Once a tree is checked incrementally, its nodes changed by @ref BasicTreeNode
+     * methods are logged and the next incremental check validates only them. Links changed
+     * by hand and nodes linked by hand are seen only by a full check.
+     * 
+     * @return Error
+     */
+    Error Verify() const;
+
+    /**
+     * @brief Checks the whole tree regardless of @ref BasicTree::verifyPolicy
      * 
      * @return Error
      */
-    Error Verify();
+    Error VerifyFull() const;
     
     /**
      * @brief Counts nodes in the tree
      * 
      * @return Error
      */
-    TreeNodeCountResult CountNodes();
+    TreeNodeCountResult CountNodes() const;
 
-    #ifndef NDEBUG
     /**
-     * @brief Recalculates @ref TreeNode::nodeCount for every node in tree
+     * @brief Counts nodes in the tree counting its subtrees on several threads
+     * 
+     * @param [in] threads - how many threads to use, 0 for one per core
+     * @return TreeNodeCountResult
+     */
+    TreeNodeCountResult CountNodes(size_t threads) const;
+
+    #ifdef TREE_SUBTREE_SIZES
+    /**
+     * @brief Recalculates @ref BasicTreeNode::nodeCount for every node in tree
      * 
      * @return Error
      */
     Error RecalculateNodes();
+
+    /**
+     * @brief Number of nodes in the tree taken from the subtree sizes
+     * 
+     * Changes only mark sizes stale, this counts what is stale and writes nothing,
+     * so it is O(1) right after @ref BasicTree::UpdateSizes.
+     * 
+     * @return TreeNodeCountResult
+     */
+    TreeNodeCountResult Size() const;
+
+    /**
+     * @brief Recounts the stale subtree sizes, visiting only stale nodes
+     * 
+     * @return TreeNodeCountResult - number of nodes in the tree
+     */
+    TreeNodeCountResult UpdateSizes();
+
+    /**
+     * @brief Finds the node at position index in in-order
+     * 
+     * Takes O(depth) once the sizes are up to date, stale ones are recounted first.
+     * 
+     * @param [in] index - from 0
+     * @return Node::Result - @ref ERROR_BAD_SIZE if index is not less than the size
+     */
+    typename Node::Result Select(size_t index);
+
+    /**
+     * @brief Position of node in in-order, the opposite of @ref BasicTree::Select
+     * 
+     * Takes O(depth) once the sizes are up to date, stale ones are recounted first.
+     * 
+     * @param [in] node - a node of this tree
+     * @return TreeNodeCountResult - @ref ERROR_BAD_TREE if the node is not in the tree
+     */
+    TreeNodeCountResult Rank(Node* node);
     #endif
 
     /**
      * @brief Draws a tree using Graphviz
      *
-     * @param [in] logFolder - where to put logs
-     *  
-     * @return Error
+     * Only a snapshot of the tree is taken here, the .dot file is written and drawn
+     * in the background, see @ref TreeDumpJob. The heading has the result of @ref BasicTree::Verify,
+     * except under @ref TREE_VERIFY_OFF and @ref TREE_VERIFY_SAMPLED, where the tree is not checked.
+     *
+     * @return Error - @ref ERROR_BAD_SIZE if too many dumps are waiting
      */
-    Error Dump();
+    Error Dump() const;
 
+    /**
+     * @brief Draws a subtree using Graphviz, collapsing what does not fit into summary nodes
+     *
+     * The heading in the log still has the error of the whole tree.
+     *
+     * @param [in] subtree - node of this tree to draw from, nullptr for the root
+     * @param [in] options
+     * @return Error - @ref ERROR_BAD_SIZE if too many dumps are waiting
+     */
+    Error Dump(Node* subtree, const TreeDumpOptions* options) const;
+
+    /**
+     * @brief Starts the html log in logFolder
+     *
+     * @param [in] logFolder - where to put logs, must live until @ref BasicTree::EndLogging
+     * @return Error
+     */
     static Error StartLogging(const char* logFolder);
+
+    /**
+     * @brief Waits for all dumps to be drawn and closes the html log
+     *
+     * @return Error
+     */
     static Error EndLogging();
 
+    /**
+     * @brief Snapshot of the instrumentation counters, shared by trees of all element types
+     *
+     * Counters are kept only in builds with TREE_STATS, see @ref TreeStats.
+     *
+     * @return TreeStats
+     */
+    static TreeStats Stats();
+
+    /**
+     * @brief Sets every instrumentation counter to zero
+     *
+     * @return Error
+     */
+    static Error ResetStats();
+
+    /**
+     * @brief Adds a table of @ref BasicTree::Stats to the html log,
+     * @ref BasicTree::EndLogging adds one in builds with TREE_STATS
+     *
+     * @return Error - @ref ERROR_BAD_FILE if the log is not started
+     */
+    static Error LogStats();
+
     /**
      * @brief Saves the tree in pre-order
      * 
+     * Values are written as the shortest text that reads back to the same value.
+     * The text is collected in a @ref TREE_WRITE_BUFFER_SIZE buffer and written in batches.
+     * 
      * @param [in] outPath - where to save
      * @return Error
      */
-    Error Print(const char* outPath);
+    Error Print(const char* outPath) const;
 
     /**
-     * @brief Read the tree in pre-order
+     * @brief Saves the tree in pre-order to memory, same text as @ref BasicTree::Print
+     * 
+     * @return TreeBufferResult - the text, free it with free()
+     */
+    TreeBufferResult PrintToBuffer() const;
+
+    /**
+     * @brief Read the tree in pre-order into the tree's own pool
+     * 
+     * The file is read in chunks of @ref TREE_READ_CHUNK_SIZE and nodes are built
+     * as the words come, so pipes and stdin work too.
      * 
      * @attention Make sure to delete the tree before reading into it
      * 
@@ -177,4 +414,69 @@ struct Tree
      * @return Error
      */
     Error Read(const char* readPath);
+
+    /**
+     * @brief Read the tree in pre-order into the tree's own pool
+     * 
+     * @attention Make sure to delete the tree before reading into it
+     * 
+     * @param [in] readFile - what to read, stays open
+     * @return Error
+     */
+    Error Read(FILE* readFile);
+
+    /**
+     * @brief Builds a perfectly balanced tree over values in the tree's own pool
+     *
+     * The middle value becomes the root and each half goes the same way, so an
+     * in-order walk gives the values back in their order and sorted values make
+     * a search tree. Nodes are cut from the fresh pool one after another in pre-order
+     * and get their subtree sizes right away, nothing is walked twice.
+     *
+     * @attention Make sure to delete the tree before building into it
+     *
+     * @param [in] values - in the order an in-order walk should give them
+     * @param [in] count - how many values, at least one
+     * @return Error
+     */
+    Error BuildFromSorted(const T* values, size_t count);
+
+    /**
+     * @brief Same as @ref BasicTree::BuildFromSorted, but the halves deep enough
+     * are built on several threads, each in its own pool merged into the tree's one
+     *
+     * Less than @ref TREE_PARALLEL_CUTOFF values are built on one thread.
+     *
+     * @param [in] values
+     * @param [in] count
+     * @param [in] threads - how many threads to use, 0 for one per core
+     * @return Error
+     */
+    Error BuildFromSorted(const T* values, size_t count, size_t threads);
+
+    /**
+     * @brief Saves the tree in the binary format described in @ref TreeBinary.hpp
+     * 
+     * @param [in] outPath - where to save
+     * @return Error
+     */
+    Error WriteBinary(const char* outPath) const;
+
+    /**
+     * @brief Reads the tree saved by @ref BasicTree::WriteBinary into the tree's own pool
+     * 
+     * Regular files are mapped into memory and nodes are built right from the mapped
+     * image, anything else (pipes, stdin) is read in chunks.
+     * 
+     * @attention Make sure to delete the tree before reading into it
+     * 
+     * @param [in] readPath - what to read
+     * @return Error
+     */
+    Error ReadBinary(const char* readPath);
 };
+
+typedef BasicTreeNode<TreeElement_t>       TreeNode;
+typedef BasicTreeNodeResult<TreeElement_t> TreeNodeResult;
+typedef BasicTreeNodePool<TreeElement_t>   TreeNodePool;
+typedef BasicTree<TreeElement_t>           Tree;
@@ -0,0 +1,70 @@
+//! @file
+
+#pragma once
+
+#include <stdint.h>
+#include "TreeSettings.hpp"
+
+/*
+ * Binary tree file:
+ *     TreeBinaryHeader
+ *     shape  - 2 bits per node in pre-order, bit 0: has left, bit 1: has right,
+ *              padded with zeros to a multiple of 8 bytes
+ *     values - nodeCount raw elements in pre-order
+ * Numbers are stored in the byte order of the machine which wrote the file.
+ */
+
+static const char     TREE_BINARY_SIGNATURE[8] = "TREEBIN";
+static const uint32_t TREE_BINARY_VERSION      = 2;
+
+static const uint8_t  TREE_BINARY_HAS_LEFT     = 1;
+static const uint8_t  TREE_BINARY_HAS_RIGHT    = 2;
+
+static const size_t   TREE_BINARY_CHUNK_VALUES = 1 << 16;
+
+/*
+ * Shared subtrees file, written by BasicInternTable::WriteBinary:
+ *     TreeBinaryHeader with TREE_DAG_SIGNATURE, nodeCount is the number of distinct subtrees
+ *     nodeCount records in post-order, each one
+ *         uint32_t left  - index of the left child plus one, 0 if there is none
+ *         uint32_t right - the same for the right child
+ *         element  value - raw
+ * Children always come before their parents, the root is the last record.
+ */
+
+static const char     TREE_DAG_SIGNATURE[8] = "TREEDAG";
+static const uint32_t TREE_DAG_VERSION      = 1;
+
+/** @struct TreeBinaryHeader
+ * @brief Starts a binary tree file
+ *
+ * @var TreeBinaryHeader::signature - @ref TREE_BINARY_SIGNATURE
+ * @var TreeBinaryHeader::version - @ref TREE_BINARY_VERSION
+ * @var TreeBinaryHeader::elementSize - size of an element of the writer
+ * @var TreeBinaryHeader::elementKind - TreeElementTraits::KIND of the element type
+ * @var TreeBinaryHeader::nodeCount - number of nodes
+ */
+struct TreeBinaryHeader
+{
+    char     signature[8];
+    uint32_t version;
+    uint16_t elementSize;
+    uint16_t elementKind;
+    uint64_t nodeCount;
+};
+
+/**
+ * @brief Size of the padded shape section for nodeCount nodes
+ */
+static inline size_t TreeBinaryShapeSize(size_t nodeCount)
+{
+    return (nodeCount * 2 + 63) / 64 * 8;
+}
+
+/**
+ * @brief Shape bits of the node with the given pre-order index
+ */
+static inline uint8_t TreeBinaryGetShape(const uint8_t* shape, size_t index)
+{
+    return (shape[index / 4] >> (index % 4 * 2)) & 3;
+}
@@ -0,0 +1,143 @@
+//! @file
+
+#pragma once
+
+#include "Tree.hpp"
+
+typedef uint32_t TreeIndex_t;
+
+// no node, used for missing children and the parent of the root
+static const TreeIndex_t TREE_COMPACT_NONE = UINT32_MAX;
+
+struct TreeIndexResult
+{
+    TreeIndex_t value;
+    Error       error;
+};
+
+/** @struct BasicCompactTree
+ * @brief Binary tree kept in arrays and linked by 32 bit indices
+ *
+ * Values, left, right and parent links lie in separate arrays, node i being
+ * the i-th element of each, so a walk reads 16 bytes per node instead of a whole
+ * @ref BasicTreeNode and the tree is copied with memcpy. Nodes are only added,
+ * @ref BasicCompactTree::FromTree puts them in pre-order, so walks go through
+ * the arrays front to back.
+ *
+ * @var BasicCompactTree::values - node values
+ * @var BasicCompactTree::left - left children
+ * @var BasicCompactTree::right - right children
+ * @var BasicCompactTree::parent - parents
+ * @var BasicCompactTree::root - index of the root, @ref TREE_COMPACT_NONE if empty
+ * @var BasicCompactTree::size - number of nodes in the arrays
+ * @var BasicCompactTree::capacity - number of nodes the arrays can hold
+ */
+template <typename T, typename Traits = TreeElementTraits<T>>
+struct BasicCompactTree
+{
+    typedef BasicTree<T, Traits> PointerTree;
+
+    T*           values;
+    TreeIndex_t* left;
+    TreeIndex_t* right;
+    TreeIndex_t* parent;
+
+    TreeIndex_t  root;
+    size_t       size;
+    size_t       capacity;
+
+    /**
+     * @brief Initializes an empty tree
+     *
+     * @param [in] capacity - how many nodes to make room for
+     * @return Error
+     */
+    Error Init(size_t capacity);
+
+    /**
+     * @brief Frees the arrays
+     *
+     * @return Error
+     */
+    Error Destructor();
+
+    /**
+     * @brief Makes room for capacity nodes
+     *
+     * @param [in] capacity
+     * @return Error - @ref ERROR_BAD_SIZE if the indices do not fit in @ref TreeIndex_t
+     */
+    Error Reserve(size_t capacity);
+
+    /**
+     * @brief Adds a node without links, the first one becomes the root
+     *
+     * @param [in] value
+     * @return TreeIndexResult - index of the node
+     */
+    TreeIndexResult Add(T value);
+
+    /**
+     * @brief Sets the left child of node
+     *
+     * @param [in] node - a node without a left child
+     * @param [in] left - a node without a parent
+     * @return Error - @ref ERROR_BAD_TREE if node already has a left child
+     */
+    Error SetLeft(TreeIndex_t node, TreeIndex_t left);
+
+    /**
+     * @brief Sets the right child of node
+     *
+     * @param [in] node - a node without a right child
+     * @param [in] right - a node without a parent
+     * @return Error - @ref ERROR_BAD_TREE if node already has a right child
+     */
+    Error SetRight(TreeIndex_t node, TreeIndex_t right);
+
+    /**
+     * @brief Checks links of every node and that all of them hang from the root
+     *
+     * @return Error
+     */
+    Error Verify();
+
+    /**
+     * @brief Counts nodes reachable from the root
+     *
+     * @return TreeNodeCountResult
+     */
+    TreeNodeCountResult CountNodes();
+
+    /**
+     * @brief Makes this tree a copy of source with one memcpy per array
+     *
+     * @attention This tree must be initialized
+     *
+     * @param [in] source
+     * @return Error
+     */
+    Error Copy(const BasicCompactTree* source);
+
+    /**
+     * @brief Replaces the nodes with the nodes of tree in pre-order
+     *
+     * @attention This tree must be initialized
+     *
+     * @param [in] tree
+     * @return Error
+     */
+    Error FromTree(PointerTree* tree);
+
+    /**
+     * @brief Builds a pointer tree in its own pool from this one
+     *
+     * @attention Make sure to delete the tree before building into it
+     *
+     * @param [out] tree
+     * @return Error
+     */
+    Error ToTree(PointerTree* tree);
+};
+
+typedef BasicCompactTree<TreeElement_t> CompactTree;
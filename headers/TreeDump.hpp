@@ -0,0 +1,100 @@
+//! @file
+
+#pragma once
+
+#include "Tree.hpp"
+
+static const size_t TREE_DUMP_VALUE_LENGTH = 32;
+
+/** @struct TreeDumpNode
+ * @brief What a dump shows of a node, copied when the dump is asked for
+ * 
+ * @var TreeDumpNode::left - index of the left child in the snapshot, 0 if there is none
+ * @var TreeDumpNode::right - index of the right child in the snapshot, 0 if there is none
+ * @var TreeDumpNode::value - the value as text, so the job does not depend on the element type,
+ * the smallest value of a collapsed subtree
+ * @var TreeDumpNode::maxValue - the largest value of a collapsed subtree
+ * @var TreeDumpNode::depth - depth from the dumped root
+ * @var TreeDumpNode::collapsed - nodes of the subtree this summary node stands for, 0 for a node
+ */
+struct TreeDumpNode
+{
+    size_t left;
+    size_t right;
+    char   value[TREE_DUMP_VALUE_LENGTH];
+    char   maxValue[TREE_DUMP_VALUE_LENGTH];
+    size_t id;
+    size_t nodeCount;
+    size_t depth;
+    size_t collapsed;
+};
+
+/** @struct TreeDumpJob
+ * @brief A snapshot of a tree waiting to be written to .dot and drawn
+ * 
+ * Jobs are done by a background worker: it writes the .dot file and starts
+ * Graphviz, keeping at most @ref TREE_DUMP_MAX_RENDERS of them running.
+ * 
+ * @var TreeDumpJob::logFolder - where dot/ and img/ are
+ * @var TreeDumpJob::iteration - number of the dump
+ * @var TreeDumpJob::errorName - result of @ref BasicTree::Verify, "not checked" if it was skipped
+ * @var TreeDumpJob::treeSize - @ref BasicTree::Size, 0 without @ref TREE_SUBTREE_SIZES
+ * @var TreeDumpJob::options - what is collapsed and how labels look
+ * @var TreeDumpJob::nodes - snapshot in breadth first order, the root first
+ */
+struct TreeDumpJob
+{
+    const char*     logFolder;
+    size_t          iteration;
+    const char*     errorName;
+    size_t          treeSize;
+    TreeDumpOptions options;
+
+    TreeDumpNode*   nodes;
+    size_t          nodesCount;
+    size_t          nodesCapacity;
+
+    /**
+     * @brief Takes a snapshot of the subtree, collapsed subtrees are walked
+     * only to sum them up
+     * 
+     * @param [in] root
+     * @param [in] options
+     * @return Error
+     */
+    template <typename T, typename Traits>
+    Error Init(BasicTreeNode<T, Traits>* root, const TreeDumpOptions* options);
+
+    /**
+     * @brief Frees the snapshot
+     * 
+     * @return Error
+     */
+    Error Destructor();
+
+    /**
+     * @brief Writes the snapshot as a Graphviz graph through one buffered writer,
+     * the caller flushes it
+     * 
+     * @param [in] writer
+     * @return Error
+     */
+    Error WriteDot(TreeTextWriter* writer) const;
+
+    /**
+     * @brief Gives the job to the background worker without waiting
+     * 
+     * @attention The job must be allocated with calloc, the worker frees it.
+     * If the queue is full, the job is not taken and @ref ERROR_BAD_SIZE is returned.
+     * 
+     * @return Error
+     */
+    Error Submit();
+
+    /**
+     * @brief Waits until every submitted job is written and drawn, then stops the worker
+     * 
+     * @return Error
+     */
+    static Error Drain();
+};
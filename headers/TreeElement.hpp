@@ -0,0 +1,120 @@
+//! @file
+
+#pragma once
+
+#include <charconv>
+#include <limits>
+#include <math.h>
+#include <stdint.h>
+#include "TreeText.hpp"
+
+/** @struct TreeElementTraits
+ * @brief What a tree needs to know about its element type
+ *
+ * A specialization gives:
+ * - POISON - value of an empty or deleted node;
+ * - NAME - name of the type in logs;
+ * - KIND - number of the type in binary files, 0 is not used;
+ * - MAX_LENGTH - longest text @ref Format writes;
+ * - Id - type of @ref BasicTreeNode::id, the node is laid out as pointers, value, id,
+ *   so a 4 byte element with a 4 byte id makes a 32 byte node. The top bit of the id
+ *   is taken by @ref BasicTreeNode::red;
+ * - Parse - reads the whole token into a value, false if it is not one;
+ * - Format - writes the value to [begin, end), returns the end of the text or nullptr.
+ *
+ * To use another type add a specialization and put the type in @ref TREE_ELEMENT_TYPES.
+ */
+template <typename T>
+struct TreeElementTraits;
+
+template <>
+struct TreeElementTraits<double>
+{
+    typedef size_t Id;
+
+    static constexpr double      POISON     = INFINITY;
+    static constexpr const char* NAME       = "double";
+    static constexpr uint16_t    KIND       = 1;
+    // sign, 17 digits, point and exponent
+    static constexpr size_t      MAX_LENGTH = 32;
+
+    static inline bool Parse(TreeToken token, double* value)
+    {
+        return TreeParseDouble(token, value);
+    }
+
+    // the shortest text that reads back to the same value
+    static inline char* Format(char* begin, char* end, double value)
+    {
+        std::to_chars_result result = std::to_chars(begin, end, value);
+        return result.ec == std::errc() ? result.ptr : nullptr;
+    }
+};
+
+template <>
+struct TreeElementTraits<float>
+{
+    typedef uint32_t Id;
+
+    static constexpr float       POISON     = INFINITY;
+    static constexpr const char* NAME       = "float";
+    static constexpr uint16_t    KIND       = 2;
+    static constexpr size_t      MAX_LENGTH = 24;
+
+    static inline bool Parse(TreeToken token, float* value)
+    {
+        const char* end = token.begin + token.length;
+        if (token.length > 1 && *token.begin == '+' && token.begin[1] != '-')
+            token.begin++;
+
+        std::from_chars_result result = std::from_chars(token.begin, end, *value);
+        return result.ec == std::errc() && result.ptr == end;
+    }
+
+    static inline char* Format(char* begin, char* end, float value)
+    {
+        std::to_chars_result result = std::to_chars(begin, end, value);
+        return result.ec == std::errc() ? result.ptr : nullptr;
+    }
+};
+
+/**
+ * @brief Traits shared by integer elements, the poison is the smallest value
+ */
+template <typename T, typename IdType, uint16_t Kind>
+struct TreeIntegerTraits
+{
+    typedef IdType Id;
+
+    static constexpr T        POISON     = std::numeric_limits<T>::min();
+    static constexpr uint16_t KIND       = Kind;
+    static constexpr size_t   MAX_LENGTH = std::numeric_limits<T>::digits10 + 3;
+
+    static inline bool Parse(TreeToken token, T* value)
+    {
+        const char* end = token.begin + token.length;
+        if (token.length > 1 && *token.begin == '+' && token.begin[1] != '-')
+            token.begin++;
+
+        std::from_chars_result result = std::from_chars(token.begin, end, *value);
+        return result.ec == std::errc() && result.ptr == end;
+    }
+
+    static inline char* Format(char* begin, char* end, T value)
+    {
+        std::to_chars_result result = std::to_chars(begin, end, value);
+        return result.ec == std::errc() ? result.ptr : nullptr;
+    }
+};
+
+template <>
+struct TreeElementTraits<int32_t> : TreeIntegerTraits<int32_t, uint32_t, 3>
+{
+    static constexpr const char* NAME = "int32";
+};
+
+template <>
+struct TreeElementTraits<int64_t> : TreeIntegerTraits<int64_t, size_t, 4>
+{
+    static constexpr const char* NAME = "int64";
+};
@@ -0,0 +1,149 @@
+//! @file
+
+#pragma once
+
+#include "Tree.hpp"
+
+/**
+ * @brief Operators of an expression tree, inner nodes hold them as their values
+ *
+ * A node with one child is unary: ADD keeps the value, SUB negates it, MUL and DIV
+ * have no unary form.
+ */
+enum TreeOperator
+{
+    TREE_OPERATOR_ADD,
+    TREE_OPERATOR_SUB,
+    TREE_OPERATOR_MUL,
+    TREE_OPERATOR_DIV,
+
+    TREE_OPERATORS_COUNT,
+};
+
+/**
+ * @brief Instructions of a @ref TreeExpression
+ *
+ * PUSH puts its operand on the stack, the others change the top of the stack.
+ * A unary minus is a multiplication by -1.
+ */
+enum TreeExpressionOp
+{
+    TREE_EXPRESSION_PUSH,
+    TREE_EXPRESSION_ADD,
+    TREE_EXPRESSION_SUB,
+    TREE_EXPRESSION_MUL,
+    TREE_EXPRESSION_DIV,
+};
+
+/**
+ * @brief Where the operand of an instruction comes from: popped from the stack,
+ * the constant of the instruction or a column of the input
+ */
+enum TreeExpressionSource
+{
+    TREE_EXPRESSION_STACK,
+    TREE_EXPRESSION_CONSTANT,
+    TREE_EXPRESSION_COLUMN,
+};
+
+/** @struct TreeExpressionInstruction
+ * @brief One step of a @ref TreeExpression
+ *
+ * A binary instruction computes top = top op operand, or operand op top
+ * if it is reversed, so the operands may be computed in any order.
+ *
+ * @var TreeExpressionInstruction::constant - operand if source is @ref TREE_EXPRESSION_CONSTANT
+ * @var TreeExpressionInstruction::column - operand if source is @ref TREE_EXPRESSION_COLUMN
+ */
+struct TreeExpressionInstruction
+{
+    TreeExpressionOp     op;
+    TreeExpressionSource source;
+    bool                 reversed;
+    double               constant;
+    size_t               column;
+};
+
+/** @struct TreeExpression
+ * @brief Arithmetic expression tree compiled to flat postfix code, evaluated
+ * over many rows at once
+ *
+ * Inner nodes of the tree hold @ref TreeOperator codes. A leaf made by
+ * @ref TreeExpressionColumn reads that column of the row, any other leaf is a
+ * constant.
+ *
+ * The input is columnar, one array of values per column. Rows go in blocks of
+ * @ref TREE_EXPRESSION_BLOCK_SIZE and each instruction runs over a whole block,
+ * so the cost of decoding it is shared by the rows and the arithmetic is done
+ * with AVX-512 or AVX vectors where the target has them (-DTREE_NATIVE=ON), with
+ * a scalar loop otherwise. Leaves are folded into the instructions that use them
+ * and the heavier operand is computed first, so the stack of blocks stays short.
+ *
+ * @var TreeExpression::code - instructions in the order they run
+ * @var TreeExpression::size - number of instructions
+ * @var TreeExpression::columns - number of columns a row has
+ * @var TreeExpression::stackSize - most blocks on the stack at once
+ */
+struct TreeExpression
+{
+    typedef BasicTree<double> PointerTree;
+
+    TreeExpressionInstruction* code;
+    size_t                     size;
+    size_t                     columns;
+    size_t                     stackSize;
+
+    /**
+     * @brief Initializes an empty expression
+     *
+     * @return Error
+     */
+    Error Init();
+
+    /**
+     * @brief Frees the code
+     *
+     * @return Error
+     */
+    Error Destructor();
+
+    /**
+     * @brief Replaces the code with the code of tree, walking it once
+     *
+     * @param [in] tree
+     * @param [in] columns - how many columns a row has
+     * @return Error - @ref ERROR_SYNTAX if an inner node does not hold an operator, a unary
+     * node is MUL or DIV, or a leaf reads a column past columns
+     */
+    Error Compile(const PointerTree* tree, size_t columns);
+
+    /**
+     * @brief Evaluates the expression for rows rows
+     *
+     * @param [in] columns - @ref TreeExpression::columns arrays of rows values
+     * @param [in] rows
+     * @param [out] results - rows values
+     * @return Error
+     */
+    Error Evaluate(const double* const* columns, size_t rows, double* results) const;
+};
+
+/**
+ * @brief Leaf value that reads column of the row
+ *
+ * The column is kept in the payload of a quiet NaN no arithmetic makes, so it
+ * never collides with a constant. Text dumps print it as nan.
+ *
+ * @param [in] column - below 2^32
+ * @return double - a plain NaN constant if column does not fit
+ */
+double TreeExpressionColumn(size_t column);
+
+/**
+ * @brief Whether value was made by @ref TreeExpressionColumn
+ *
+ * @param [in] value
+ * @param [out] column - the column it reads, may be nullptr
+ * @return bool
+ */
+bool TreeExpressionIsColumn(double value, size_t* column);
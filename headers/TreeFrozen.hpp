@@ -0,0 +1,99 @@
+//! @file
+
+#pragma once
+
+#include "Tree.hpp"
+
+/** @struct BasicFrozenTree
+ * @brief Read-only search copy of a tree whose in-order walk is sorted,
+ * laid out in one array in Eytzinger (breadth first) order
+ *
+ * The node in slot k has its children in slots 2k and 2k + 1, slot 0 is unused,
+ * so no links are kept and the top levels share a few cache lines. The descent
+ * steps to 2k + (value is smaller) without branching and prefetches the line
+ * with the descendants several levels down, so the next misses overlap.
+ *
+ * Only the values are kept: the shape of the original tree does not matter,
+ * the frozen tree is as balanced as a tree of that size can be.
+ *
+ * @var BasicFrozenTree::values - slots 1..size, aligned to @ref TREE_CACHE_LINE_SIZE
+ * @var BasicFrozenTree::size - number of values
+ */
+template <typename T, typename Traits = TreeElementTraits<T>>
+struct BasicFrozenTree
+{
+    typedef BasicTreeNode<T, Traits> Node;
+
+    T*     values;
+    size_t size;
+
+    /**
+     * @brief Initializes an empty tree
+     *
+     * @return Error
+     */
+    Error Init();
+
+    /**
+     * @brief Frees the values
+     *
+     * @return Error
+     */
+    Error Destructor();
+
+    /**
+     * @brief Replaces the values with the values under root, in one in-order walk
+     *
+     * Any tree works as long as it is ordered: a @ref BasicSearchTree, a tree
+     * from @ref BasicTree::BuildFromSorted or one built by hand.
+     *
+     * @param [in] root
+     * @return Error - @ref ERROR_BAD_TREE if the in-order walk is not sorted
+     */
+    Error Freeze(Node* root);
+
+    /**
+     * @brief Finds the first value not less than value
+     *
+     * @param [in] value
+     * @return const T* - nullptr if all values are less
+     */
+    const T* LowerBound(T value) const;
+
+    /**
+     * @brief Finds value
+     *
+     * @param [in] value
+     * @return const T* - nullptr if there is none
+     */
+    const T* Find(T value) const;
+
+    /**
+     * @brief @ref BasicFrozenTree::LowerBound for many keys at once
+     *
+     * Keys go down in groups of @ref TREE_BATCH_LANES, all of them one level per step,
+     * so the cache misses of a group overlap instead of coming one after another.
+     * Every lane takes as many steps as the tree has levels and the step has no
+     * branches, so the compiler turns it into vector gathers and compares where
+     * the target has them (AVX2 with -DTREE_NATIVE=ON).
+     *
+     * @param [in] keys
+     * @param [in] count
+     * @param [out] found - count pointers, nullptr for keys greater than all values
+     * @return Error
+     */
+    Error LowerBoundBatch(const T* keys, size_t count, const T** found) const;
+
+    /**
+     * @brief @ref BasicFrozenTree::Find for many keys at once, goes as
+     * @ref BasicFrozenTree::LowerBoundBatch
+     *
+     * @param [in] keys
+     * @param [in] count
+     * @param [out] found - count pointers, nullptr for missing keys
+     * @return Error
+     */
+    Error FindBatch(const T* keys, size_t count, const T** found) const;
+};
+
+typedef BasicFrozenTree<TreeElement_t> FrozenTree;
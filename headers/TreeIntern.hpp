@@ -0,0 +1,152 @@
+//! @file
+
+#pragma once
+
+#include "Tree.hpp"
+
+template <typename T, typename Traits>
+struct BasicInternNode;
+
+template <typename T, typename Traits = TreeElementTraits<T>>
+struct BasicInternNodeResult
+{
+    const BasicInternNode<T, Traits>* value;
+    Error                             error;
+};
+
+/** @struct BasicInternNode
+ * @brief Node of a @ref BasicInternTable, the only one with its value and children
+ *
+ * Nodes are never changed and may have many parents, so there is no parent link.
+ *
+ * @var BasicInternNode::hash - structural hash of the subtree, the same in every run
+ * @var BasicInternNode::id - number of the node in its table, children have smaller ones
+ */
+template <typename T, typename Traits = TreeElementTraits<T>>
+struct BasicInternNode
+{
+    typedef BasicInternNodeResult<T, Traits> Result;
+
+    const BasicInternNode* left;
+    const BasicInternNode* right;
+    T                      value;
+    uint64_t               hash;
+    size_t                 id;
+};
+
+struct TreeInternSlab;
+
+/** @struct BasicInternTable
+ * @brief Builds trees with every distinct subtree made once (hash-consing)
+ *
+ * @ref BasicInternTable::Make returns the node which is already in the table if
+ * there is one with the same value and children. As children are made the same
+ * way, equal subtrees are the same node, so trees become DAGs and comparing
+ * subtrees of one table is comparing pointers, see @ref BasicInternTable::Equal.
+ * Values are compared bit by bit, so 0 and -0 are different.
+ *
+ * Nodes live as long as the table and are freed with it slab by slab.
+ * A table is used by one thread at a time.
+ *
+ * @var BasicInternTable::slots - open addressing table of the nodes
+ * @var BasicInternTable::capacity - number of slots, a power of two
+ * @var BasicInternTable::count - number of nodes
+ * @var BasicInternTable::slabs - memory of the nodes
+ */
+template <typename T, typename Traits = TreeElementTraits<T>>
+struct BasicInternTable
+{
+    typedef BasicInternNode<T, Traits> Node;
+    typedef BasicTree<T, Traits>       PointerTree;
+
+    const Node**    slots;
+    size_t          capacity;
+    size_t          count;
+    TreeInternSlab* slabs;
+
+    /**
+     * @brief Initializes an empty table
+     *
+     * @return Error
+     */
+    Error Init();
+
+    /**
+     * @brief Frees every node of the table
+     *
+     * @return Error
+     */
+    Error Destructor();
+
+    /**
+     * @brief The node with value and children, made if there is none yet
+     *
+     * @param [in] value
+     * @param [in] left - a node of this table or nullptr
+     * @param [in] right - a node of this table or nullptr
+     * @return Node::Result
+     */
+    typename Node::Result Make(T value, const Node* left, const Node* right);
+
+    /**
+     * @brief Whether two subtrees of this table are equal, in O(1)
+     *
+     * @param [in] first
+     * @param [in] second
+     * @return bool
+     */
+    static bool Equal(const Node* first, const Node* second)
+    {
+        return first == second;
+    }
+
+    /**
+     * @brief Makes every subtree of tree, bottom-up
+     *
+     * @param [in] tree
+     * @return Node::Result - the root
+     */
+    typename Node::Result FromTree(const PointerTree* tree);
+
+    /**
+     * @brief Builds a pointer tree in its own pool, a shared subtree is copied
+     * every time it is met
+     *
+     * @attention Make sure to delete the tree before building into it
+     *
+     * @param [in] root
+     * @param [out] tree
+     * @return Error
+     */
+    Error ToTree(const Node* root, PointerTree* tree) const;
+
+    /**
+     * @brief Counts distinct subtrees under root, root included
+     *
+     * @param [in] root
+     * @return TreeNodeCountResult
+     */
+    TreeNodeCountResult CountUnique(const Node* root) const;
+
+    /**
+     * @brief Saves the DAG under root in the format described in @ref TreeBinary.hpp,
+     * each distinct subtree once
+     *
+     * @param [in] root
+     * @param [in] outPath
+     * @return Error - @ref ERROR_BAD_SIZE if there are more distinct subtrees than 32 bit indices hold
+     */
+    Error WriteBinary(const Node* root, const char* outPath) const;
+
+    /**
+     * @brief Reads a DAG saved by @ref BasicInternTable::WriteBinary into this table,
+     * subtrees which are already here are reused
+     *
+     * @param [in] readPath
+     * @return Node::Result - the root
+     */
+    typename Node::Result ReadBinary(const char* readPath);
+};
+
+typedef BasicInternNode<TreeElement_t>  InternNode;
+typedef BasicInternTable<TreeElement_t> InternTable;
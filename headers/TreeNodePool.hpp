@@ -0,0 +1,137 @@
+//! @file
+
+#pragma once
+
+#include "Utils.hpp"
+#include "TreeSettings.hpp"
+#include "TreeElement.hpp"
+
+template <typename T, typename Traits = TreeElementTraits<T>>
+struct BasicTreeNode;
+
+template <typename T, typename Traits = TreeElementTraits<T>>
+struct BasicTreeNodeResult;
+
+template <typename T, typename Traits = TreeElementTraits<T>>
+struct BasicTreeNodePool;
+
+/** @struct TreeNodeSlab
+ * @brief Header of a @ref TREE_SLAB_SIZE aligned block which nodes are cut from
+ * 
+ * @var TreeNodeSlab::pool - the pool the slab belongs to
+ * @var TreeNodeSlab::next - previous slab of the pool
+ * @var TreeNodeSlab::used - how many nodes were cut from the slab
+ */
+template <typename Pool>
+struct TreeNodeSlab
+{
+    Pool*         pool;
+    TreeNodeSlab* next;
+    size_t        used;
+};
+
+/** @struct BasicTreeNodePool
+ * @brief Slab allocator for @ref BasicTreeNode, one pool holds nodes of one element type
+ * 
+ * Nodes are cut from big aligned slabs one after another, so nodes created
+ * together lie together in memory. Freed nodes go to a free list and are reused.
+ * The pool a node belongs to is found by aligning the node's address down to the slab.
+ * 
+ * A pool is used by one thread at a time, except @ref BasicTreeNodePool::Shared:
+ * each thread keeps a cache of its nodes and takes or gives back
+ * @ref TREE_NODE_CACHE_SIZE of them at once under a lock. Nodes in the caches
+ * count as in use.
+ * 
+ * @var BasicTreeNodePool::slabs - the newest slab, others are linked through @ref TreeNodeSlab::next
+ * @var BasicTreeNodePool::freeList - freed nodes linked through @ref BasicTreeNode::left
+ * @var BasicTreeNodePool::slabCount - number of slabs
+ * @var BasicTreeNodePool::nodesInUse - number of allocated and not freed nodes
+ */
+template <typename T, typename Traits>
+struct BasicTreeNodePool
+{
+    typedef BasicTreeNode<T, Traits>        Node;
+    typedef BasicTreeNodeResult<T, Traits>  NodeResult;
+    typedef TreeNodeSlab<BasicTreeNodePool> Slab;
+
+    Slab*  slabs;
+    Node*  freeList;
+    size_t slabCount;
+    size_t nodesInUse;
+
+    /**
+     * @brief Initializes an empty pool
+     * 
+     * @return Error
+     */
+    Error Init();
+
+    /**
+     * @brief Releases every slab of the pool at once
+     * 
+     * @attention All nodes of the pool become invalid
+     * 
+     * @return Error
+     */
+    Error Destructor();
+
+    /**
+     * @brief Gives a zeroed node
+     * 
+     * @return NodeResult
+     */
+    NodeResult Allocate();
+
+    /**
+     * @brief Moves all slabs and free nodes of other to this pool, other is left empty
+     * 
+     * Nodes stay where they are, only their slabs change the owner.
+     * 
+     * @param [in] other
+     * @return Error
+     */
+    Error Merge(BasicTreeNodePool* other);
+
+    /**
+     * @brief Returns the node to its pool
+     * 
+     * @param [in] node
+     * @return Error
+     */
+    static Error Free(Node* node);
+
+    /**
+     * @brief Returns count nodes linked through left from head to tail, all of this pool
+     * 
+     * @param [in] head
+     * @param [in] tail
+     * @param [in] count
+     * @return Error
+     */
+    Error FreeChain(Node* head, Node* tail, size_t count);
+
+    /**
+     * @brief Gives the nodes cached by the calling thread back to @ref BasicTreeNodePool::Shared
+     * 
+     * @attention Call it before a thread which used the shared pool exits,
+     * otherwise its cached nodes stay taken until the pool is destroyed
+     * 
+     * @return Error
+     */
+    static Error ReleaseCache();
+
+    /**
+     * @brief Finds the pool the node was allocated from
+     * 
+     * @param [in] node
+     * @return BasicTreeNodePool*
+     */
+    static BasicTreeNodePool* Of(const Node* node);
+
+    /**
+     * @brief The pool used when no other is given
+     * 
+     * @return BasicTreeNodePool*
+     */
+    static BasicTreeNodePool* Shared();
+};
@@ -0,0 +1,127 @@
+//! @file
+
+#pragma once
+
+#include <atomic>
+#include <pthread.h>
+#include <unistd.h>
+#include "Utils.hpp"
+#include "TreeSettings.hpp"
+
+/** @struct TreeParallelJob
+ * @brief State shared by the threads of @ref TreeParallelFor
+ *
+ * @var TreeParallelJob::next - the next task to take
+ * @var TreeParallelJob::failed - a task failed, the rest are not started
+ * @var TreeParallelJob::error - error of the first failed task
+ */
+template <typename Func>
+struct TreeParallelJob
+{
+    Func*               func;
+    size_t              tasksCount;
+    std::atomic<size_t> next;
+    std::atomic<bool>   failed;
+    pthread_mutex_t     mutex;
+    Error               error;
+};
+
+/** @struct TreeParallelWorker
+ * @brief Argument of a thread of @ref TreeParallelFor
+ */
+template <typename Func>
+struct TreeParallelWorker
+{
+    TreeParallelJob<Func>* job;
+    size_t                 index;
+    pthread_t              thread;
+};
+
+template <typename Func>
+static void* _treeParallelWork(void* argument)
+{
+    TreeParallelWorker<Func>* worker = (TreeParallelWorker<Func>*)argument;
+    TreeParallelJob<Func>*    job    = worker->job;
+
+    while (!job->failed.load(std::memory_order_relaxed))
+    {
+        size_t task = job->next.fetch_add(1, std::memory_order_relaxed);
+        if (task >= job->tasksCount)
+            break;
+
+        Error error = (*job->func)(task, worker->index);
+        if (error)
+        {
+            pthread_mutex_lock(&job->mutex);
+            if (!job->failed.exchange(true))
+                job->error = error;
+            pthread_mutex_unlock(&job->mutex);
+        }
+    }
+
+    return nullptr;
+}
+
+/**
+ * @brief Number of threads to use when none is given
+ */
+static inline size_t TreeParallelThreads()
+{
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores < 1)
+        return 1;
+
+    return (size_t)cores < TREE_PARALLEL_MAX_THREADS ? (size_t)cores : TREE_PARALLEL_MAX_THREADS;
+}
+
+/**
+ * @brief Calls func(task, worker) for every task in [0, tasksCount) on several threads
+ *
+ * Threads take the next task as soon as they finish one, so tasks of different
+ * sizes even out when there are several tasks per thread. The calling thread is
+ * worker 0 and the others are numbered up to threads - 1.
+ *
+ * @param [in] tasksCount
+ * @param [in] threads - how many threads to use, at most @ref TREE_PARALLEL_MAX_THREADS
+ * @param [in] func - Error func(size_t task, size_t worker)
+ * @return Error - of the first failed task, tasks after it may not be done
+ */
+template <typename Func>
+static inline Error TreeParallelFor(size_t tasksCount, size_t threads, Func func)
+{
+    if (threads > TREE_PARALLEL_MAX_THREADS)
+        threads = TREE_PARALLEL_MAX_THREADS;
+    if (threads > tasksCount)
+        threads = tasksCount;
+    if (threads == 0)
+        return Error();
+
+    TreeParallelJob<Func> job = {};
+    job.func       = &func;
+    job.tasksCount = tasksCount;
+    pthread_mutex_init(&job.mutex, nullptr);
+
+    TreeParallelWorker<Func> workers[TREE_PARALLEL_MAX_THREADS] = {};
+
+    // a thread which could not be started just leaves its share to the others
+    size_t started = 1;
+    for (; started < threads; started++)
+    {
+        workers[started].job   = &job;
+        workers[started].index = started;
+
+        if (pthread_create(&workers[started].thread, nullptr, _treeParallelWork<Func>, &workers[started]) != 0)
+            break;
+    }
+
+    workers[0].job   = &job;
+    workers[0].index = 0;
+    _treeParallelWork<Func>(&workers[0]);
+
+    for (size_t worker = 1; worker < started; worker++)
+        pthread_join(workers[worker].thread, nullptr);
+
+    pthread_mutex_destroy(&job.mutex);
+
+    return job.error;
+}
@@ -0,0 +1,120 @@
+//! @file
+
+#pragma once
+
+#include <atomic>
+#include "Tree.hpp"
+
+/** @struct BasicPersistentNode
+ * @brief Node shared by versions of a @ref BasicPersistentTree
+ *
+ * There is no parent link, as a shared node has a parent in every version
+ * that holds it. A node is never changed once it is in a version.
+ *
+ * @var BasicPersistentNode::refs - parents and version roots holding the node
+ */
+template <typename T, typename Traits = TreeElementTraits<T>>
+struct BasicPersistentNode
+{
+    BasicPersistentNode* left;
+    BasicPersistentNode* right;
+    T                    value;
+    std::atomic<size_t>  refs;
+};
+
+/** @struct BasicPersistentTree
+ * @brief Version of a tree which shares unchanged subtrees with other versions
+ *
+ * @ref BasicPersistentTree::Snapshot takes another handle to the same nodes in O(1).
+ * An update copies only the nodes on the way from the root to the changed one,
+ * the new copies point to the old subtrees off the way, so it costs O(depth) time
+ * and memory and other versions do not see it. Nodes are counted by reference,
+ * the last version holding a node frees it, from any thread.
+ *
+ * Nodes are addressed by paths: a string of 'L' and 'R' steps from the root,
+ * "" is the root itself.
+ *
+ * @var BasicPersistentTree::root - nullptr if the version is empty
+ */
+template <typename T, typename Traits = TreeElementTraits<T>>
+struct BasicPersistentTree
+{
+    typedef BasicPersistentNode<T, Traits> Node;
+    typedef BasicTree<T, Traits>           PointerTree;
+
+    Node* root;
+
+    /**
+     * @brief Initializes an empty version
+     *
+     * @return Error
+     */
+    Error Init();
+
+    /**
+     * @brief Drops this version, nodes no other version holds are freed
+     *
+     * @return Error
+     */
+    Error Destructor();
+
+    /**
+     * @brief Makes snapshot another version with the same nodes, in O(1)
+     *
+     * @attention snapshot must not hold a version
+     *
+     * @param [out] snapshot
+     * @return Error
+     */
+    Error Snapshot(BasicPersistentTree* snapshot) const;
+
+    /**
+     * @brief Finds the node at path
+     *
+     * @param [in] path - 'L' and 'R' steps
+     * @return const Node* - nullptr if there is no such node or path is bad
+     */
+    const Node* At(const char* path) const;
+
+    /**
+     * @brief Sets the value at path, the last step may lead to a missing child,
+     * then a leaf is added there
+     *
+     * @param [in] path - 'L' and 'R' steps
+     * @param [in] value
+     * @return Error - @ref ERROR_SYNTAX if path has other characters,
+     * @ref ERROR_NULLPTR if it goes through a missing node
+     */
+    Error Set(const char* path, T value);
+
+    /**
+     * @brief Removes the subtree at path
+     *
+     * @param [in] path - 'L' and 'R' steps
+     * @return Error - @ref ERROR_SYNTAX if path has other characters,
+     * @ref ERROR_NULLPTR if there is no such node
+     */
+    Error Remove(const char* path);
+
+    /**
+     * @brief Replaces this version with a copy of tree
+     *
+     * @param [in] tree
+     * @return Error
+     */
+    Error FromTree(const PointerTree* tree);
+
+    /**
+     * @brief Builds a pointer tree in its own pool from this version,
+     * to print, dump or change it in place
+     *
+     * @attention Make sure to delete the tree before building into it
+     *
+     * @param [out] tree
+     * @return Error
+     */
+    Error ToTree(PointerTree* tree) const;
+};
+
+typedef BasicPersistentNode<TreeElement_t> PersistentNode;
+typedef BasicPersistentTree<TreeElement_t> PersistentTree;
@@ -0,0 +1,105 @@
+//! @file
+
+#pragma once
+
+#include "Tree.hpp"
+
+/** @struct BasicSearchTree
+ * @brief Ordered set of values kept in a red-black tree of @ref BasicTreeNode
+ *
+ * Values are ordered by operator <, equal values are kept once. Inserting
+ * and erasing rebalance the tree with rotations through the parent links,
+ * so it stays O(log n) deep whatever order the values come in. The color of
+ * a node is @ref BasicTreeNode::red, so nodes take no more memory.
+ *
+ * The nodes are ordinary tree nodes in a pool of the tree: walks, printing
+ * and dumps work on @ref BasicSearchTree::root as on any other tree, but
+ * changing links by hand breaks the order.
+ *
+ * @var BasicSearchTree::root - root of the tree, nullptr if empty
+ * @var BasicSearchTree::pool - pool owned by the tree
+ * @var BasicSearchTree::size - number of values
+ */
+template <typename T, typename Traits = TreeElementTraits<T>>
+struct BasicSearchTree
+{
+    typedef BasicTreeNode<T, Traits>     Node;
+    typedef BasicTreeNodePool<T, Traits> Pool;
+
+    Node*  root;
+    Pool*  pool;
+    size_t size;
+
+    /**
+     * @brief Initializes an empty tree with its own pool
+     *
+     * @return Error
+     */
+    Error Init();
+
+    /**
+     * @brief Releases the pool with all nodes
+     *
+     * @return Error
+     */
+    Error Destructor();
+
+    /**
+     * @brief Adds value if it is not in the tree yet
+     *
+     * @param [in] value
+     * @return Node::Result - the node holding value, the old one if it was there
+     */
+    typename Node::Result Insert(T value);
+
+    /**
+     * @brief Finds the node holding value
+     *
+     * @param [in] value
+     * @return Node* - nullptr if there is none
+     */
+    Node* Find(T value) const;
+
+    /**
+     * @brief Finds the first node whose value is not less than value
+     *
+     * @param [in] value
+     * @return Node* - nullptr if all values are less
+     */
+    Node* LowerBound(T value) const;
+
+    /**
+     * @brief Removes value from the tree
+     *
+     * @param [in] value
+     * @return TreeNodeCountResult - how many nodes were removed, 0 or 1
+     */
+    TreeNodeCountResult Erase(T value);
+
+    /**
+     * @brief The node with the smallest value
+     *
+     * @return Node* - nullptr if the tree is empty
+     */
+    Node* First() const;
+
+    /**
+     * @brief The node with the next value, goes through the parent links
+     *
+     * A range [low, high) is visited as
+     * for (Node* node = tree.LowerBound(low); node && node->value < high; node = tree.Next(node))
+     *
+     * @param [in] node
+     * @return Node* - nullptr after the last one
+     */
+    static Node* Next(Node* node);
+
+    /**
+     * @brief Checks links, order, colors and size of the whole tree
+     *
+     * @return Error - @ref ERROR_BAD_TREE if the order or the colors are broken
+     */
+    Error Verify() const;
+};
+
+typedef BasicSearchTree<TreeElement_t> SearchTree;
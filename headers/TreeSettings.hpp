@@ -2,13 +2,79 @@
 #define TREE_SETTINGS_INI
 
 #include <math.h>
+#include <stdint.h>
 
+// element type of Tree and TreeNode, others are used through BasicTree<T>
 typedef double TreeElement_t;
-static const TreeElement_t TREE_POISON = INFINITY;
-static const size_t MAX_TREE_SIZE = 1000;
+
+/**
+ * @brief Element types the tree is compiled for, each needs a @ref TreeElementTraits
+ */
+#define TREE_ELEMENT_TYPES(X)   \
+    X(double)                   \
+    X(float)                    \
+    X(int32_t)                  \
+    X(int64_t)
+
 static const char*  TREE_WORD_SEPARATOR = ";";
-#define TREE_ELEMENT_SPECIFIER "%lg"
 
 static const size_t BAD_ID = 0;
 
+/**
+ * @brief Keeps @ref BasicTreeNode::nodeCount in release builds too,
+ * debug builds always keep it to verify trees
+ */
+#if !defined(NDEBUG) && !defined(TREE_SUBTREE_SIZES)
+#define TREE_SUBTREE_SIZES
+#endif
+
+// nodeCount of a node whose subtree changed, a real count is at least 1
+static const size_t TREE_SIZE_STALE = 0;
+
+static const size_t TREE_SLAB_SIZE = 1 << 16;
+// nodes of the shared pool a thread takes or gives back at once
+static const size_t TREE_NODE_CACHE_SIZE = 256;
+// node ids a thread takes from the common counter at once
+static const size_t TREE_ID_BLOCK_SIZE = 1024;
+static const size_t TREE_CACHE_LINE_SIZE = 64;
+// keys a batch lookup of a frozen tree walks down side by side
+static const size_t TREE_BATCH_LANES = 16;
+static const size_t TREE_READ_CHUNK_SIZE = 1 << 16;
+static const size_t TREE_WRITE_BUFFER_SIZE = 1 << 20;
+// rows a compiled expression evaluates together, a multiple of the values in a cache line
+static const size_t TREE_EXPRESSION_BLOCK_SIZE = 512;
+
+// subtrees smaller than the cutoff are copied, deleted and counted on one thread
+static const size_t TREE_PARALLEL_CUTOFF           = 1 << 16;
+static const size_t TREE_PARALLEL_TASKS_PER_THREAD = 8;
+static const size_t TREE_PARALLEL_MAX_THREADS      = 64;
+
+static const size_t TREE_DUMP_QUEUE_SIZE   = 64;
+static const size_t TREE_DUMP_MAX_RENDERS  = 4;
+// deepest level @ref BasicTree::Dump draws as it is, deeper subtrees are collapsed
+static const size_t TREE_DUMP_MAX_DEPTH    = 1000;
+// nodes a dump draws as they are, the rest is collapsed into summary nodes
+static const size_t TREE_DUMP_MAX_NODES    = 1 << 12;
+
+/**
+ * @brief How much of the tree @ref Tree::Verify checks in debug builds
+ *
+ * OFF checks only the root, SAMPLED checks the whole tree every
+ * @ref TREE_VERIFY_SAMPLE_PERIOD calls, INCREMENTAL checks the nodes touched
+ * since the last incremental check, FULL counts every node on every call.
+ * DEFAULT means @ref TREE_VERIFY_POLICY.
+ */
+enum TreeVerifyPolicy
+{
+    TREE_VERIFY_DEFAULT,
+    TREE_VERIFY_OFF,
+    TREE_VERIFY_SAMPLED,
+    TREE_VERIFY_INCREMENTAL,
+    TREE_VERIFY_FULL,
+};
+
+static const TreeVerifyPolicy TREE_VERIFY_POLICY        = TREE_VERIFY_FULL;
+static const size_t           TREE_VERIFY_SAMPLE_PERIOD = 64;
+static const size_t           TREE_VERIFY_MAX_TOUCHED   = 1 << 20;
+
 #endif
@@ -0,0 +1,155 @@
+//! @file
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include "Utils.hpp"
+#include "TreeSettings.hpp"
+
+#ifdef TREE_STATS
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+#endif
+
+/**
+ * @brief Operations counted by the instrumentation, see @ref TreeStats
+ *
+ * INVALIDATE_SIZES and UPDATE_SIZES are the climbs which mark sizes stale after
+ * a change and the walks which recount them. RENDER is the background work of a
+ * dump: writing the .dot file and starting Graphviz. ALLOCATE_SLAB is a slab of
+ * a node pool taken from the system.
+ */
+enum TreeStatsOperation
+{
+    TREE_STATS_VERIFY,
+    TREE_STATS_VERIFY_FULL,
+    TREE_STATS_INVALIDATE_SIZES,
+    TREE_STATS_UPDATE_SIZES,
+    TREE_STATS_COUNT_NODES,
+    TREE_STATS_READ,
+    TREE_STATS_READ_BINARY,
+    TREE_STATS_PRINT,
+    TREE_STATS_WRITE_BINARY,
+    TREE_STATS_DUMP,
+    TREE_STATS_RENDER,
+    TREE_STATS_ALLOCATE_SLAB,
+
+    TREE_STATS_OPERATIONS_COUNT,
+};
+
+/** @struct TreeOperationStats
+ * @brief Counters of one @ref TreeStatsOperation
+ *
+ * @var TreeOperationStats::calls - how many times it ran
+ * @var TreeOperationStats::cycles - time stamp counter ticks spent in it,
+ * an operation which runs another one inside counts its time too
+ * @var TreeOperationStats::nodes - nodes it visited or made
+ * @var TreeOperationStats::bytes - bytes it read, wrote or allocated
+ */
+struct TreeOperationStats
+{
+    uint64_t calls;
+    uint64_t cycles;
+    uint64_t nodes;
+    uint64_t bytes;
+};
+
+/** @struct TreeStats
+ * @brief Snapshot of the counters of all trees, taken by @ref BasicTree::Stats
+ *
+ * The counters are kept only in builds with TREE_STATS, otherwise they stay zero
+ * and the instrumentation compiles to nothing.
+ */
+struct TreeStats
+{
+    TreeOperationStats operations[TREE_STATS_OPERATIONS_COUNT];
+
+    /**
+     * @brief Short name of the operation, as in the html log
+     *
+     * @param [in] operation
+     * @return const char*
+     */
+    static const char* OperationName(TreeStatsOperation operation);
+
+    /**
+     * @brief Writes the counters as an html table
+     *
+     * @param [in] htmlFile
+     * @return Error
+     */
+    Error WriteHtml(FILE* htmlFile) const;
+};
+
+/** @struct TreeStatsCounters
+ * @brief Live counters of one operation, on their own cache line so threads
+ * counting different operations do not slow each other down
+ */
+struct alignas(TREE_CACHE_LINE_SIZE) TreeStatsCounters
+{
+    std::atomic<uint64_t> calls;
+    std::atomic<uint64_t> cycles;
+    std::atomic<uint64_t> nodes;
+    std::atomic<uint64_t> bytes;
+};
+
+extern TreeStatsCounters TREE_STATS_COUNTERS[TREE_STATS_OPERATIONS_COUNT];
+
+#ifdef TREE_STATS
+/**
+ * @brief Time stamp counter, nanoseconds where there is none
+ */
+static inline uint64_t TreeStatsStart()
+{
+    #if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+    #else
+    timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (uint64_t)time.tv_sec * 1000000000 + (uint64_t)time.tv_nsec;
+    #endif
+}
+
+/**
+ * @brief Counts a call of operation which started at start
+ */
+static inline void TreeStatsEnd(TreeStatsOperation operation, uint64_t start)
+{
+    TreeStatsCounters* counters = &TREE_STATS_COUNTERS[operation];
+
+    counters->calls.fetch_add(1, std::memory_order_relaxed);
+    counters->cycles.fetch_add(TreeStatsStart() - start, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Adds nodes and bytes to operation, once per call and not once per node
+ */
+static inline void TreeStatsAdd(TreeStatsOperation operation, uint64_t nodes, uint64_t bytes)
+{
+    TreeStatsCounters* counters = &TREE_STATS_COUNTERS[operation];
+
+    if (nodes)
+        counters->nodes.fetch_add(nodes, std::memory_order_relaxed);
+    if (bytes)
+        counters->bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+#else
+static inline uint64_t TreeStatsStart()
+{
+    return 0;
+}
+
+static inline void TreeStatsEnd(TreeStatsOperation, uint64_t)
+{
+}
+
+static inline void TreeStatsAdd(TreeStatsOperation, uint64_t, uint64_t)
+{
+}
+#endif
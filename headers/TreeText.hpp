@@ -0,0 +1,189 @@
+//! @file
+
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+#include "Utils.hpp"
+#include "TreeSettings.hpp"
+
+/** @struct TreeToken
+ * @brief A word between two @ref TREE_WORD_SEPARATOR without surrounding spaces
+ * 
+ * @var TreeToken::begin - first char, nullptr at the end of input
+ * @var TreeToken::length - number of chars
+ */
+struct TreeToken
+{
+    const char* begin;
+    size_t      length;
+};
+
+struct TreeTokenResult
+{
+    TreeToken value;
+    Error     error;
+};
+
+/** @struct TreeTextReader
+ * @brief Splits a text tree into words reading it chunk by chunk
+ * 
+ * Memory does not depend on the input size, but a word must fit in
+ * @ref TREE_READ_CHUNK_SIZE. Works on pipes and stdin as well as files.
+ * 
+ * @var TreeTextReader::file - what is read
+ * @var TreeTextReader::buffer - @ref TREE_READ_CHUNK_SIZE bytes of input
+ * @var TreeTextReader::size - bytes in the buffer
+ * @var TreeTextReader::pos - start of the next word in the buffer
+ * @var TreeTextReader::eof - the file is over, only the buffer is left
+ */
+struct TreeTextReader
+{
+    FILE*  file;
+    char*  buffer;
+    size_t size;
+    size_t pos;
+    bool   eof;
+
+    /**
+     * @brief Initializes the reader
+     * 
+     * @param [in] file - what to read, stays open
+     * @return Error
+     */
+    Error Init(FILE* file);
+
+    /**
+     * @brief Frees the buffer
+     * 
+     * @return Error
+     */
+    Error Destructor();
+
+    /**
+     * @brief Gives the next non-empty word
+     * 
+     * @attention The word lives until the next call
+     * 
+     * @return TreeTokenResult - word with begin = nullptr at the end of input
+     */
+    TreeTokenResult NextToken();
+};
+
+/**
+ * @brief Parses the whole token as a double without locale and sscanf
+ * 
+ * Numbers with a mantissa up to 2^53 and a power of ten up to 22 are converted
+ * exactly right away, others go to std::from_chars.
+ * 
+ * @param [in] token
+ * @param [out] value
+ * @return true if the whole token is a number, false if value is nullptr
+ */
+bool TreeParseDouble(TreeToken token, double* value);
+
+/** @struct TreeBuffer
+ * @brief Text of a tree in memory, free data with free()
+ * 
+ * @var TreeBuffer::data - the text, not null terminated
+ * @var TreeBuffer::size - number of bytes
+ */
+struct TreeBuffer
+{
+    char*  data;
+    size_t size;
+};
+
+struct TreeBufferResult
+{
+    TreeBuffer value;
+    Error      error;
+};
+
+/** @struct TreeTextWriter
+ * @brief Collects a text tree in a big buffer and passes it to write() in batches
+ * 
+ * With fd = -1 nothing is written and the buffer grows, holding the whole text.
+ * 
+ * @var TreeTextWriter::fd - where to write, -1 to keep the text in memory
+ * @var TreeTextWriter::buffer - collected text
+ * @var TreeTextWriter::size - bytes in the buffer
+ * @var TreeTextWriter::capacity - buffer capacity
+ */
+struct TreeTextWriter
+{
+    int    fd;
+    char*  buffer;
+    size_t size;
+    size_t capacity;
+
+    /**
+     * @brief Initializes the writer
+     * 
+     * @param [in] fd - where to write, stays open, -1 to keep the text in memory
+     * @return Error
+     */
+    Error Init(int fd);
+
+    /**
+     * @brief Frees the buffer
+     * 
+     * @return Error
+     */
+    Error Destructor();
+
+    /**
+     * @brief Writes the buffer to @ref TreeTextWriter::fd and empties it
+     * 
+     * @return Error
+     */
+    Error Flush();
+
+    /**
+     * @brief Makes room for at least length more bytes
+     * 
+     * @param [in] length
+     * @return Error
+     */
+    Error Reserve(size_t length);
+
+    /**
+     * @brief Appends bytes
+     * 
+     * @param [in] data
+     * @param [in] length
+     * @return Error
+     */
+    inline Error Write(const char* data, size_t length)
+    {
+        if (this->size + length > this->capacity)
+            RETURN_ERROR(this->Reserve(length));
+
+        memcpy(this->buffer + this->size, data, length);
+        this->size += length;
+
+        return Error();
+    }
+
+    /**
+     * @brief Appends the value as Traits::Format writes it
+     * 
+     * @tparam Traits - @ref TreeElementTraits of the value
+     * @param [in] value
+     * @return Error
+     */
+    template <typename Traits, typename T>
+    inline Error WriteElement(T value)
+    {
+        if (this->size + Traits::MAX_LENGTH > this->capacity)
+            RETURN_ERROR(this->Reserve(Traits::MAX_LENGTH));
+
+        char* end = Traits::Format(this->buffer + this->size, this->buffer + this->capacity, value);
+        if (!end)
+            return CREATE_ERROR(ERROR_BAD_SIZE);
+
+        this->size = (size_t)(end - this->buffer);
+
+        return Error();
+    }
+};
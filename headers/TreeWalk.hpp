@@ -0,0 +1,144 @@
+//! @file
+
+#pragma once
+
+#include "Tree.hpp"
+
+/** @struct TreeVisitor
+ * @brief Hooks called by @ref TreeWalk, override the ones you need
+ *
+ * Enter is called before the left subtree (pre-order), Between after the left
+ * and before the right subtree (in-order), Leave after both subtrees (post-order).
+ * Leave may free the node, the walk does not touch it afterwards.
+ * Descend decides whether to go into a child at the given depth.
+ */
+struct TreeVisitor
+{
+    template <typename Node> Error Enter(Node*, size_t)       { return Error(); }
+    template <typename Node> Error Between(Node*, size_t)     { return Error(); }
+    template <typename Node> Error Leave(Node*, size_t)       { return Error(); }
+    template <typename Node> bool  Descend(Node*, size_t)     { return true;    }
+};
+
+/**
+ * @brief Walks the subtree of start in depth-first order without recursion
+ *
+ * The walk goes down by child links and climbs back by @ref BasicTreeNode::parent,
+ * so it needs no stack and works on trees of any depth. A child whose parent
+ * does not point back, a node being both children or a way back to start
+ * are reported as @ref ERROR_TREE_LOOP.
+ *
+ * @param [in] start - root of the subtree, its parent is never touched
+ * @param [in] visitor - @ref TreeVisitor
+ * @return Error
+ */
+template <typename Node, typename Visitor>
+static inline Error TreeWalk(Node* start, Visitor& visitor)
+{
+    SoftAssert(start, ERROR_NULLPTR);
+
+    enum { WALK_ENTERED, WALK_LEFT_DONE, WALK_RIGHT_DONE } state = WALK_ENTERED;
+
+    Node*  node  = start;
+    size_t depth = 0;
+
+    RETURN_ERROR(visitor.Enter(node, depth));
+
+    while (true)
+    {
+        if (state == WALK_ENTERED)
+        {
+            Node* left = node->left;
+            if (left && visitor.Descend(left, depth + 1))
+            {
+                if (left->parent != node || left == node->right || left == start)
+                    return CREATE_ERROR(ERROR_TREE_LOOP);
+
+                node = left;
+                depth++;
+                RETURN_ERROR(visitor.Enter(node, depth));
+                continue;
+            }
+            state = WALK_LEFT_DONE;
+        }
+
+        if (state == WALK_LEFT_DONE)
+        {
+            RETURN_ERROR(visitor.Between(node, depth));
+
+            Node* right = node->right;
+            if (right && visitor.Descend(right, depth + 1))
+            {
+                if (right->parent != node || right == start)
+                    return CREATE_ERROR(ERROR_TREE_LOOP);
+
+                node  = right;
+                state = WALK_ENTERED;
+                depth++;
+                RETURN_ERROR(visitor.Enter(node, depth));
+                continue;
+            }
+            state = WALK_RIGHT_DONE;
+        }
+
+        if (node == start)
+            return visitor.Leave(node, depth);
+
+        Node* parent       = node->parent;
+        bool  cameFromLeft = parent->left == node;
+
+        RETURN_ERROR(visitor.Leave(node, depth));
+
+        node  = parent;
+        state = cameFromLeft ? WALK_LEFT_DONE : WALK_RIGHT_DONE;
+        depth--;
+    }
+}
+
+/**
+ * @brief Calls func(node, depth) for every node in pre-order
+ */
+template <typename Node, typename Func>
+static inline Error TreePreOrder(Node* start, Func func)
+{
+    struct : TreeVisitor
+    {
+        Func* func;
+        Error Enter(Node* node, size_t depth) { return (*func)(node, depth); }
+    } visitor;
+    visitor.func = &func;
+
+    return TreeWalk(start, visitor);
+}
+
+/**
+ * @brief Calls func(node, depth) for every node in in-order
+ */
+template <typename Node, typename Func>
+static inline Error TreeInOrder(Node* start, Func func)
+{
+    struct : TreeVisitor
+    {
+        Func* func;
+        Error Between(Node* node, size_t depth) { return (*func)(node, depth); }
+    } visitor;
+    visitor.func = &func;
+
+    return TreeWalk(start, visitor);
+}
+
+/**
+ * @brief Calls func(node, depth) for every node in post-order
+ */
+template <typename Node, typename Func>
+static inline Error TreePostOrder(Node* start, Func func)
+{
+    struct : TreeVisitor
+    {
+        Func* func;
+        Error Leave(Node* node, size_t depth) { return (*func)(node, depth); }
+    } visitor;
+    visitor.func = &func;
+
+    return TreeWalk(start, visitor);
+}
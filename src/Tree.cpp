@@ -1,37 +1,194 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "Tree.hpp"
+#include "TreeWalk.hpp"
+#include "TreeParallel.hpp"
+#include "TreeBinary.hpp"
+#include "TreeText.hpp"
+#include "TreeDump.hpp"
 #include "MinMax.hpp"
 
 static const size_t MAX_PATH_LENGTH = 128;
-static const size_t MAX_COMMAND_LENGTH = 256;
 
-static FILE*        HTML_FILE  = NULL;
-static const char*  LOG_FOLDER = nullptr;
+static FILE*        HTML_FILE      = NULL;
+static const char*  LOG_FOLDER     = nullptr;
+// shared by trees of all element types, so their pictures do not overwrite each other
+static std::atomic<size_t> DUMP_ITERATION(0);
 
-static TreeNodeResult _recCopy(TreeNode* node);
+// guards pools while several threads free nodes
+static pthread_mutex_t PARALLEL_MUTEX = PTHREAD_MUTEX_INITIALIZER;
 
-#ifndef NDEBUG
-static Error _recUpdateParentNodeCount(TreeNode* node, ssize_t change);
+/** @struct TreeIdBlock
+ * @brief Ids a thread took from the common counter and gives out one by one
+ */
+template <typename Id>
+struct TreeIdBlock
+{
+    Id     next;
+    size_t left;
+};
+
+template <typename Node>
+static std::atomic<typename Node::ElementTraits::Id> NEXT_ID(1);
+
+template <typename Node>
+static thread_local TreeIdBlock<typename Node::ElementTraits::Id> ID_BLOCK = {};
+
+template <typename Node>
+static typename Node::ElementTraits::Id _newId();
+
+template <typename Node>
+struct SplitCopyTask;
+
+template <typename Node>
+struct SplitCopyVisitor;
+
+template <typename Node>
+static typename Node::Result _copy(Node* node, typename Node::Pool* pool);
+
+#ifdef TREE_SUBTREE_SIZES
+template <typename Node>
+static Error _invalidateSizes(Node* node);
+
+template <typename Node>
+static TreeNodeCountResult _updateSizes(Node* node);
+
+template <typename Node>
+static TreeNodeCountResult _peekSize(Node* node);
 #endif
 
-static TreeNodeCountResult _recCountNodes(TreeNode* node);
+template <typename Node>
+static TreeNodeCountResult _countNodes(Node* node);
 
-#ifndef NDEBUG
-Error _recRecalcNodes(TreeNode* node);
+template <typename Tree>
+static Error _verifyByPolicy(const Tree* tree);
+
+template <typename Tree>
+static Error _verifyFull(const Tree* tree);
+
+template <typename Node>
+static Error _detach(Node* node);
+
+template <typename Node>
+static void _poison(Node* node);
+
+template <typename Node>
+static Error _split(Node* node, size_t splitDepth, Node*** tasks, size_t* tasksCount, size_t* spineCount);
+
+template <typename Node>
+static bool _isSmall(Node* node);
+
+template <typename Node>
+static size_t _splitDepth(size_t threads);
+
+#ifdef TREE_SUBTREE_SIZES
+template <typename Node>
+static Error _recalcNodes(Node* node);
 #endif
 
-static Error _recBuildCellTemplatesGraph(TreeNode* node, FILE* outGraphFile,
-                                             size_t curDepth, const size_t maxDepth);
+template <typename Node>
+static Error _print(Node* node, TreeTextWriter* writer);
+
+template <typename Node>
+static typename Node::Result _read(TreeTextReader* reader, typename Node::Pool* pool);
+
+template <typename Node>
+struct SortedRange;
+
+template <typename Node>
+static typename Node::Result _buildSorted(const typename Node::Element* values, SortedRange<Node> range,
+                                          typename Node::Pool* pool, size_t splitDepth,
+                                          SortedRange<Node>* tasks, size_t* tasksCount);
+
+template <typename Node>
+static Error _checkBinaryHeader(const TreeBinaryHeader* header);
+
+template <typename Node>
+static typename Node::Result _readBinaryMapped(int fd, size_t fileSize, typename Node::Pool* pool);
+
+template <typename Node>
+static typename Node::Result _readBinaryStream(FILE* readFile, typename Node::Pool* pool);
+
+template <typename Pool>
+static Error _newPool(Pool** pool);
+
+template <typename Pool>
+static void _deletePool(Pool* pool);
+
+#ifndef NDEBUG
+/** @struct TreeTouchedLog
+ * @brief Nodes of one tree touched since its last incremental verification
+ *
+ * The first incremental check of a tree makes its log and marks every node
+ * with it. A change to a marked node puts the node in the log in O(1), and
+ * a subtree linked under a marked node is marked then. Nodes of trees which
+ * are not checked incrementally are not marked, so changing them logs nothing.
+ *
+ * @var TreeTouchedLog::root - root the log was made for, nullptr once it is deleted
+ * @var TreeTouchedLog::lost - too much was touched to remember or the last check failed,
+ * the next incremental check is full
+ * @var TreeTouchedLog::refs - nodes marked with the log, the last one to leave frees it
+ * @var TreeTouchedLog::mutex - checks and deletes of one tree may run on several threads
+ */
+template <typename Node>
+struct TreeTouchedLog
+{
+    Node**              nodes;
+    size_t              count;
+    size_t              capacity;
+    bool                lost;
+    std::atomic<Node*>  root;
+    std::atomic<size_t> refs;
+    pthread_mutex_t     mutex;
+};
+
+template <typename Tree>
+static Error _verifyIncremental(const Tree* tree);
+
+template <typename Tree>
+static Error _markTree(const Tree* tree, TreeTouchedLog<typename Tree::Node>* old);
 
-static Error _recDrawGraph(TreeNode* node, FILE* outGraphFile, size_t curDepth, const size_t maxDepth);
+template <typename Tree>
+static void _unmarkTree(const Tree* tree);
 
-static Error _recPrint(TreeNode* node, FILE* outFile);
+template <typename Node>
+static Error _markNodes(Node* root, TreeTouchedLog<Node>* log);
 
-static TreeNodeResult _recRead(SplitString* split, size_t* wordNum);
+template <typename Node>
+static void _touch(Node* node);
 
-static TreeNodeResult _recReadOpenBracket(SplitString* split, size_t* wordNum);
+template <typename Node>
+static void _mark(Node* node, TreeTouchedLog<Node>* log);
+
+template <typename Node>
+static void _unmark(Node* node);
+
+template <typename Node>
+static void _leave(Node* node, TreeTouchedLog<Node>* log);
+
+template <typename Node>
+static TreeTouchedLog<Node>* _newTouchedLog(Node* root);
+
+template <typename Node>
+static void _releaseTouchedLog(TreeTouchedLog<Node>* log);
+
+template <typename Node>
+static void _addTouched(TreeTouchedLog<Node>* log, Node* node);
+
+template <typename Node>
+static void _clearTouched(TreeTouchedLog<Node>* log);
+
+template <typename Node>
+static Error _verifyNode(Node* node);
+
+template <typename Node>
+static Error _verifyTouched(TreeTouchedLog<Node>* log);
+#endif
 
 #define ERR_DUMP_RET(tree)                              \
 do                                                      \
@@ -55,30 +212,40 @@ do                                                      \
     }                                                   \
 } while (0);
 
-TreeNodeResult TreeNode::New(TreeElement_t value)
+template <typename T, typename Traits>
+BasicTreeNodeResult<T, Traits> BasicTreeNode<T, Traits>::New(T value)
+{
+    return BasicTreeNode::New(value, nullptr, nullptr);
+}
+
+template <typename T, typename Traits>
+BasicTreeNodeResult<T, Traits> BasicTreeNode<T, Traits>::New(T value, BasicTreeNode* left, BasicTreeNode* right)
 {
-    return TreeNode::New(value, nullptr, nullptr);
+    return BasicTreeNode::New(value, left, right, Pool::Shared());
 }
 
-TreeNodeResult TreeNode::New(TreeElement_t value, TreeNode* left, TreeNode* right)
+template <typename T, typename Traits>
+BasicTreeNodeResult<T, Traits> BasicTreeNode<T, Traits>::New(T value, BasicTreeNode* left, BasicTreeNode* right,
+                                                             Pool* pool)
 {
-    static size_t CURRENT_ID = 1;
+    SoftAssertResult(pool, nullptr, ERROR_NULLPTR);
 
-    TreeNode* node = (TreeNode*)calloc(1, sizeof(TreeNode));
-    if (!node)
-        return { NULL, CREATE_ERROR(ERROR_NO_MEMORY) };
+    Result nodeRes = pool->Allocate();
+    RETURN_RESULT(nodeRes);
+
+    BasicTreeNode* node = nodeRes.value;
 
     node->value = value;
 
-    #ifndef NDEBUG
+    #ifdef TREE_SUBTREE_SIZES
     node->nodeCount = 1;
     #endif
 
     if (left)
     {
         left->parent = node;
-        #ifndef NDEBUG
-        node->nodeCount += left->nodeCount;
+        #ifdef TREE_SUBTREE_SIZES
+        node->nodeCount = left->nodeCount == TREE_SIZE_STALE ? TREE_SIZE_STALE : node->nodeCount + left->nodeCount;
         #endif
     }
     node->left = left;
@@ -86,610 +253,2370 @@ TreeNodeResult TreeNode::New(TreeElement_t value, TreeNode* left, TreeNode* righ
     if (right)
     {
         right->parent = node;
-        #ifndef NDEBUG
-        node->nodeCount += right->nodeCount;
+        #ifdef TREE_SUBTREE_SIZES
+        if (node->nodeCount != TREE_SIZE_STALE)
+            node->nodeCount = right->nodeCount == TREE_SIZE_STALE ? TREE_SIZE_STALE : node->nodeCount + right->nodeCount;
         #endif
     }
     node->right  = right;
     node->parent = nullptr;
-    node->id     = CURRENT_ID++;
+    node->id     = _newId<BasicTreeNode>();
+
+    #ifndef NDEBUG
+    // the new node is in no tree yet, it is marked once it is linked into one
+    if (left)
+        _touch(left);
+    if (right)
+        _touch(right);
+    #endif
 
     return { node, Error() };
 }
 
-Error TreeNode::Delete()
+/**
+ * @brief Gives the next id of the thread's block, taking @ref TREE_ID_BLOCK_SIZE ids
+ * from the common counter when the block is used up
+ */
+template <typename Node>
+static typename Node::ElementTraits::Id _newId()
 {
-    if (this->id == BAD_ID)
-        return CREATE_ERROR(ERROR_TREE_LOOP);
+    typedef typename Node::ElementTraits::Id Id;
 
-    this->id = BAD_ID;
+    TreeIdBlock<Id>& block = ID_BLOCK<Node>;
 
-    if (this->parent)
+    if (!block.left)
     {
-        if (this->parent->left == this)
-        {
-            if (this->parent->right == this)
-                return CREATE_ERROR(ERROR_TREE_LOOP);
-            this->parent->left = nullptr;
-        }
-        else if (this->parent->right == this)
-            this->parent->right = nullptr;
-        else
-            return CREATE_ERROR(ERROR_TREE_LOOP);
+        block.next = NEXT_ID<Node>.fetch_add((Id)TREE_ID_BLOCK_SIZE, std::memory_order_relaxed);
+        block.left = TREE_ID_BLOCK_SIZE;
+    }
+
+    // the top bit of the id field is taken by BasicTreeNode::red
+    static const Id ID_MASK = (Id)~(Id)0 >> 1;
+
+    Id id = block.next++ & ID_MASK;
+    block.left--;
+
+    // a narrow id wraps around, BAD_ID must not be given out
+    if (id == BAD_ID)
+        return _newId<Node>();
+
+    return id;
+}
+
+template <typename T, typename Traits>
+Error BasicTreeNode<T, Traits>::Delete()
+{
+    RETURN_ERROR(_detach(this));
+
+    return TreePostOrder(this, [](BasicTreeNode* node, size_t)
+    {
+        _poison(node);
 
         #ifndef NDEBUG
-        _recUpdateParentNodeCount(this->parent, -(ssize_t)this->nodeCount);
+        _unmark(node);
         #endif
+
+        return Pool::Free(node);
+    });
+}
+
+/** @struct FreeBatch
+ * @brief Collects freed nodes of one pool and gives them back to it at once under @ref PARALLEL_MUTEX
+ */
+template <typename Node>
+struct FreeBatch
+{
+    typename Node::Pool* pool;
+    Node*                head;
+    Node*                tail;
+    size_t               count;
+
+    void Add(Node* node)
+    {
+        typename Node::Pool* nodePool = Node::Pool::Of(node);
+        if (nodePool != this->pool)
+        {
+            this->Flush();
+            this->pool = nodePool;
+        }
+
+        node->left = this->head;
+        if (!this->head)
+            this->tail = node;
+        this->head = node;
+        this->count++;
     }
 
-    if (this->left)
+    void Flush()
     {
-        if (this->left->parent != this)
-            return CREATE_ERROR(ERROR_TREE_LOOP);
-        RETURN_ERROR(this->left->Delete());
+        if (!this->count)
+            return;
+
+        pthread_mutex_lock(&PARALLEL_MUTEX);
+        this->pool->FreeChain(this->head, this->tail, this->count);
+        pthread_mutex_unlock(&PARALLEL_MUTEX);
+
+        this->head  = nullptr;
+        this->tail  = nullptr;
+        this->count = 0;
     }
-    if (this->right)
+};
+
+template <typename T, typename Traits>
+Error BasicTreeNode<T, Traits>::Delete(size_t threads)
+{
+    if (threads == 0)
+        threads = TreeParallelThreads();
+
+    if (threads == 1 || _isSmall(this))
+        return this->Delete();
+
+    BasicTreeNode** tasks      = nullptr;
+    size_t          tasksCount = 0;
+    size_t          splitDepth = _splitDepth<BasicTreeNode>(threads);
+
+    Error error = _split(this, splitDepth, &tasks, &tasksCount, nullptr);
+    if (error || tasksCount < 2)
     {
-        if (this->right->parent != this)
-            return CREATE_ERROR(ERROR_TREE_LOOP);
-        RETURN_ERROR(this->right->Delete());
+        free(tasks);
+        return error ? error : this->Delete();
     }
 
-    this->value  = TREE_POISON;
-    this->left   = nullptr;
-    this->right  = nullptr;
-    this->parent = nullptr;
+    error = _detach(this);
 
-    #ifndef NDEBUG
-    this->nodeCount = SIZET_POISON;
-    #endif
+    if (!error)
+        error = TreeParallelFor(tasksCount, threads, [tasks](size_t task, size_t)
+        {
+            FreeBatch<BasicTreeNode> batch = {};
 
-    free(this);
+            Error error = TreePostOrder(tasks[task], [&batch](BasicTreeNode* node, size_t)
+            {
+                _poison(node);
 
-    return Error();
+                #ifndef NDEBUG
+                _unmark(node);
+                #endif
+
+                batch.Add(node);
+                return Error();
+            });
+
+            batch.Flush();
+
+            return error;
+        });
+
+    free(tasks);
+    RETURN_ERROR(error);
+
+    // the nodes above the split, their children at splitDepth are already freed
+    struct : TreeVisitor
+    {
+        size_t splitDepth;
+
+        bool Descend(BasicTreeNode*, size_t depth)
+        {
+            return depth < this->splitDepth;
+        }
+
+        Error Leave(BasicTreeNode* node, size_t)
+        {
+            _poison(node);
+
+            #ifndef NDEBUG
+            _unmark(node);
+            #endif
+
+            return Pool::Free(node);
+        }
+    } visitor;
+    visitor.splitDepth = splitDepth;
+
+    return TreeWalk(this, visitor);
+}
+
+template <typename T, typename Traits>
+BasicTreeNodeResult<T, Traits> BasicTreeNode<T, Traits>::Copy()
+{
+    return this->Copy(Pool::Shared());
 }
 
-TreeNodeResult TreeNode::Copy()
+template <typename T, typename Traits>
+BasicTreeNodeResult<T, Traits> BasicTreeNode<T, Traits>::Copy(Pool* pool)
 {
-    if (this->left && this->left->parent != this)
-        return { nullptr, CREATE_ERROR(ERROR_TREE_LOOP) };
-    if (this->right && this->right->parent != this)
-        return { nullptr, CREATE_ERROR(ERROR_TREE_LOOP) };
+    SoftAssertResult(pool, nullptr, ERROR_NULLPTR);
 
-    return _recCopy(this);
+    return _copy(this, pool);
 }
 
-Error TreeNode::SetLeft(TreeNode* left)
+template <typename T, typename Traits>
+BasicTreeNodeResult<T, Traits> BasicTreeNode<T, Traits>::Copy(Pool* pool, size_t threads)
 {
-    SoftAssert(left, ERROR_NULLPTR);
+    SoftAssertResult(pool, nullptr, ERROR_NULLPTR);
 
-    #ifndef NDEBUG
-    this->nodeCount += left->nodeCount;
-    if (this->left)
-        this->nodeCount -= this->left->nodeCount;
+    if (threads == 0)
+        threads = TreeParallelThreads();
+
+    if (threads == 1 || _isSmall(this))
+        return _copy(this, pool);
+
+    SplitCopyVisitor<BasicTreeNode> visitor = {};
+    visitor.pool       = pool;
+    visitor.splitDepth = _splitDepth<BasicTreeNode>(threads);
+
+    Error error = TreeWalk(this, visitor);
+    if (!error)
+        error = visitor.error;
+
+    if (error)
+    {
+        if (visitor.copy)
+            visitor.copy->Delete();
+        free(visitor.tasks);
+        return { nullptr, error };
+    }
+
+    Pool threadPools[TREE_PARALLEL_MAX_THREADS] = {};
+    for (size_t thread = 0; thread < threads && thread < TREE_PARALLEL_MAX_THREADS; thread++)
+        threadPools[thread].Init();
+
+    SplitCopyTask<BasicTreeNode>* tasks = visitor.tasks;
+
+    error = TreeParallelFor(visitor.tasksCount, threads, [tasks, &threadPools](size_t task, size_t thread)
+    {
+        Result copyRes = _copy(tasks[task].original, &threadPools[thread]);
+        tasks[task].copy = copyRes.value;
+
+        return copyRes.error;
+    });
+
+    for (size_t task = 0; task < visitor.tasksCount; task++)
+    {
+        BasicTreeNode* copy = tasks[task].copy;
+        if (!copy)
+            continue;
+
+        if (tasks[task].isLeft)
+            tasks[task].parentCopy->left  = copy;
+        else
+            tasks[task].parentCopy->right = copy;
+        copy->parent = tasks[task].parentCopy;
+    }
+
+    for (size_t thread = 0; thread < threads && thread < TREE_PARALLEL_MAX_THREADS; thread++)
+        pool->Merge(&threadPools[thread]);
+
+    free(tasks);
+
+    if (error)
+    {
+        visitor.copy->Delete();
+        return { nullptr, error };
+    }
+
+    #ifdef TREE_SUBTREE_SIZES
+    // counts above the split were taken before the subtrees were linked
+    struct : TreeVisitor
+    {
+        size_t splitDepth;
+
+        bool Descend(BasicTreeNode*, size_t depth)
+        {
+            return depth < this->splitDepth;
+        }
+
+        Error Leave(BasicTreeNode* node, size_t)
+        {
+            node->nodeCount = 1;
+            if (node->left)
+                node->nodeCount += node->left->nodeCount;
+            if (node->right)
+                node->nodeCount += node->right->nodeCount;
+
+            return Error();
+        }
+    } recount;
+    recount.splitDepth = visitor.splitDepth;
+
+    error = TreeWalk(visitor.copy, recount);
+    if (error)
+        return { nullptr, error };
     #endif
+
+    return { visitor.copy, Error() };
+}
+
+template <typename T, typename Traits>
+Error BasicTreeNode<T, Traits>::SetLeft(BasicTreeNode* left)
+{
+    SoftAssert(left, ERROR_NULLPTR);
+
     this->left = left;
     left->parent = this;
 
     #ifndef NDEBUG
-    if (this->parent)
-        return _recUpdateParentNodeCount(this->parent, left->nodeCount);
+    _touch(this);
+    if (this->touchedLog)
+        _mark(left, this->touchedLog);
+    #endif
+
+    #ifdef TREE_SUBTREE_SIZES
+    return _invalidateSizes(this);
+    #else
+    return Error();
+    #endif
+}
+
+template <typename T, typename Traits>
+Error BasicTreeNode<T, Traits>::SetRight(BasicTreeNode* right)
+{
+    SoftAssert(right, ERROR_NULLPTR);
+
+    this->right = right;
+    right->parent = this;
+
+    #ifndef NDEBUG
+    _touch(this);
+    if (this->touchedLog)
+        _mark(right, this->touchedLog);
+    #endif
+
+    #ifdef TREE_SUBTREE_SIZES
+    return _invalidateSizes(this);
+    #else
+    return Error();
+    #endif
+}
+
+#ifdef TREE_SUBTREE_SIZES
+template <typename T, typename Traits>
+Error BasicTreeNode<T, Traits>::InvalidateSizes()
+{
+    return _invalidateSizes(this);
+}
+#endif
+
+/** @struct CopyVisitor
+ * @brief Builds the copy while the original is walked, @ref CopyVisitor::current
+ * follows the walk through the copy's parent links.
+ */
+template <typename Node>
+struct CopyVisitor : TreeVisitor
+{
+    typename Node::Pool* pool;
+    Node*                copy;
+    Node*                current;
+
+    Error Enter(Node* node, size_t depth)
+    {
+        typename Node::Result copyRes = Node::New(node->value, nullptr, nullptr, this->pool);
+        RETURN_ERROR(copyRes.error);
+
+        Node* nodeCopy = copyRes.value;
+
+        if (depth == 0)
+            this->copy = nodeCopy;
+        else if (node->parent->left == node)
+            this->current->left  = nodeCopy;
+        else
+            this->current->right = nodeCopy;
+
+        nodeCopy->parent = this->current;
+        this->current    = nodeCopy;
+
+        return Error();
+    }
+
+    Error Leave(Node*, size_t)
+    {
+        #ifdef TREE_SUBTREE_SIZES
+        Node* nodeCopy = this->current;
+        if (nodeCopy->left)
+            nodeCopy->nodeCount += nodeCopy->left->nodeCount;
+        if (nodeCopy->right)
+            nodeCopy->nodeCount += nodeCopy->right->nodeCount;
+        #endif
+
+        this->current = this->current->parent;
+
+        return Error();
+    }
+};
+
+template <typename Node>
+static typename Node::Result _copy(Node* node, typename Node::Pool* pool)
+{
+    SoftAssertResult(node, nullptr, ERROR_NULLPTR);
+
+    CopyVisitor<Node> visitor = {};
+    visitor.pool = pool;
+
+    Error error = TreeWalk(node, visitor);
+
+    if (error)
+    {
+        if (visitor.copy)
+            visitor.copy->Delete();
+        return { nullptr, error };
+    }
+
+    return { visitor.copy, Error() };
+}
+
+/** @struct SplitCopyTask
+ * @brief A subtree hanging at the split depth, copied by one thread
+ *
+ * @var SplitCopyTask::original - root of the subtree
+ * @var SplitCopyTask::parentCopy - copy of its parent, the copy is linked to it
+ * @var SplitCopyTask::isLeft - whether the subtree is the left child
+ * @var SplitCopyTask::copy - copy of the subtree, nullptr until done
+ */
+template <typename Node>
+struct SplitCopyTask
+{
+    Node* original;
+    Node* parentCopy;
+    bool  isLeft;
+    Node* copy;
+};
+
+/** @struct SplitCopyVisitor
+ * @brief Copies the nodes above splitDepth and leaves the subtrees below as tasks
+ *
+ * @var SplitCopyVisitor::original - original of @ref CopyVisitor::current
+ */
+template <typename Node>
+struct SplitCopyVisitor : CopyVisitor<Node>
+{
+    size_t               splitDepth;
+    Node*                original;
+    SplitCopyTask<Node>* tasks;
+    size_t               tasksCount;
+    size_t               tasksCapacity;
+    Error                error;
+
+    Error Enter(Node* node, size_t depth)
+    {
+        RETURN_ERROR(CopyVisitor<Node>::Enter(node, depth));
+        this->original = node;
+
+        return Error();
+    }
+
+    Error Leave(Node* node, size_t depth)
+    {
+        RETURN_ERROR(CopyVisitor<Node>::Leave(node, depth));
+        this->original = this->original->parent;
+
+        return Error();
+    }
+
+    bool Descend(Node* child, size_t depth)
+    {
+        if (depth < this->splitDepth)
+            return true;
+
+        if (this->error)
+            return false;
+
+        Node* parent = this->original;
+        if (child->parent != parent || parent->left == parent->right)
+        {
+            this->error = CREATE_ERROR(ERROR_TREE_LOOP);
+            return false;
+        }
+
+        if (this->tasksCount == this->tasksCapacity)
+        {
+            size_t               newCapacity = this->tasksCapacity ? 2 * this->tasksCapacity : 64;
+            SplitCopyTask<Node>* newTasks    = (SplitCopyTask<Node>*)realloc(this->tasks,
+                                                                             newCapacity * sizeof(*newTasks));
+            if (!newTasks)
+            {
+                this->error = CREATE_ERROR(ERROR_NO_MEMORY);
+                return false;
+            }
+
+            this->tasks         = newTasks;
+            this->tasksCapacity = newCapacity;
+        }
+
+        this->tasks[this->tasksCount++] = { child, this->current, parent->left == child, nullptr };
+
+        return false;
+    }
+};
+
+template <typename Node>
+static Error _detach(Node* node)
+{
+    if (node->id == BAD_ID)
+        return CREATE_ERROR(ERROR_TREE_LOOP);
+
+    node->id = BAD_ID;
+
+    Node* parent = node->parent;
+    if (!parent)
+        return Error();
+
+    if (parent->left == node)
+    {
+        if (parent->right == node)
+            return CREATE_ERROR(ERROR_TREE_LOOP);
+        parent->left = nullptr;
+    }
+    else if (parent->right == node)
+        parent->right = nullptr;
+    else
+        return CREATE_ERROR(ERROR_TREE_LOOP);
+
+    #ifdef TREE_SUBTREE_SIZES
+    return _invalidateSizes(parent);
+    #else
+    return Error();
+    #endif
+}
+
+template <typename Node>
+static void _poison(Node* node)
+{
+    node->value  = Node::ElementTraits::POISON;
+    node->left   = nullptr;
+    node->right  = nullptr;
+    node->parent = nullptr;
+    node->id     = BAD_ID;
+    node->red    = 0;
+
+    #ifdef TREE_SUBTREE_SIZES
+    node->nodeCount = SIZET_POISON;
     #endif
+}
+
+/**
+ * @brief Whether the subtree has less than @ref TREE_PARALLEL_CUTOFF nodes,
+ * the walk stops as soon as it sees that many
+ */
+template <typename Node>
+static bool _isSmall(Node* node)
+{
+    struct : TreeVisitor
+    {
+        size_t count;
+
+        bool Descend(Node*, size_t)
+        {
+            return this->count < TREE_PARALLEL_CUTOFF;
+        }
+
+        Error Enter(Node*, size_t)
+        {
+            this->count++;
+            return Error();
+        }
+    } visitor;
+    visitor.count = 0;
+
+    // a broken tree is left to the one thread version to report
+    if (TreeWalk(node, visitor))
+        return true;
+
+    return visitor.count < TREE_PARALLEL_CUTOFF;
+}
+
+/**
+ * @brief Depth at which a full tree has @ref TREE_PARALLEL_TASKS_PER_THREAD subtrees per thread
+ */
+template <typename Node>
+static size_t _splitDepth(size_t threads)
+{
+    size_t depth = 0;
+    while (((size_t)1 << depth) < threads * TREE_PARALLEL_TASKS_PER_THREAD)
+        depth++;
+
+    return depth;
+}
+
+/** @struct SplitVisitor
+ * @brief Collects subtrees hanging at splitDepth and counts the nodes above them
+ */
+template <typename Node>
+struct SplitVisitor : TreeVisitor
+{
+    size_t splitDepth;
+    Node** tasks;
+    size_t tasksCount;
+    size_t tasksCapacity;
+    size_t spineCount;
+    Error  error;
+
+    bool Descend(Node* child, size_t depth)
+    {
+        if (depth < this->splitDepth)
+            return true;
+
+        if (this->error)
+            return false;
+
+        if (this->tasksCount == this->tasksCapacity)
+        {
+            size_t newCapacity = this->tasksCapacity ? 2 * this->tasksCapacity : 64;
+            Node** newTasks    = (Node**)realloc(this->tasks, newCapacity * sizeof(*newTasks));
+            if (!newTasks)
+            {
+                this->error = CREATE_ERROR(ERROR_NO_MEMORY);
+                return false;
+            }
+
+            this->tasks         = newTasks;
+            this->tasksCapacity = newCapacity;
+        }
+
+        this->tasks[this->tasksCount++] = child;
+
+        return false;
+    }
+
+    Error Enter(Node*, size_t)
+    {
+        this->spineCount++;
+        return Error();
+    }
+};
+
+/**
+ * @brief Collects the subtrees hanging at splitDepth, each becomes a task
+ *
+ * @param [in] node
+ * @param [in] splitDepth
+ * @param [out] tasks - roots of the subtrees, free it with free()
+ * @param [out] tasksCount
+ * @param [out] spineCount - number of nodes above splitDepth, may be nullptr
+ * @return Error
+ */
+template <typename Node>
+static Error _split(Node* node, size_t splitDepth, Node*** tasks, size_t* tasksCount, size_t* spineCount)
+{
+    SplitVisitor<Node> visitor = {};
+    visitor.splitDepth = splitDepth;
+
+    Error error = TreeWalk(node, visitor);
+    if (!error)
+        error = visitor.error;
+
+    *tasks      = visitor.tasks;
+    *tasksCount = visitor.tasksCount;
+    if (spineCount)
+        *spineCount = visitor.spineCount;
+
+    return error;
+}
+
+#ifdef TREE_SUBTREE_SIZES
+/**
+ * @brief Marks the sizes of node and its ancestors stale
+ *
+ * The climb stops at the first ancestor which is already stale, as all of its
+ * ancestors are stale too. So a batch of changes in one place costs one climb,
+ * and a loop of parent links ends the climb as well.
+ */
+template <typename Node>
+static Error _invalidateSizes(Node* node)
+{
+    SoftAssert(node, ERROR_NULLPTR);
+
+    uint64_t start = TreeStatsStart();
+    size_t   nodes = 0;
+    Error    error = Error();
+
+    for (Node* ancestor = node; ancestor && ancestor->nodeCount != TREE_SIZE_STALE; ancestor = ancestor->parent)
+    {
+        ancestor->nodeCount = TREE_SIZE_STALE;
+        nodes++;
+
+        Node* parent = ancestor->parent;
+        if (parent && parent->left != ancestor && parent->right != ancestor)
+        {
+            error = CREATE_ERROR(ERROR_TREE_LOOP);
+            break;
+        }
+    }
+
+    TreeStatsEnd(TREE_STATS_INVALIDATE_SIZES, start);
+    TreeStatsAdd(TREE_STATS_INVALIDATE_SIZES, nodes, 0);
+
+    return error;
+}
+
+/** @struct StaleSizesVisitor
+ * @brief Goes only into stale subtrees, fresh children are taken as they are
+ *
+ * @var StaleSizesVisitor::update - write the sizes back, otherwise only count
+ * @var StaleSizesVisitor::count - nodes of the stale nodes visited so far, plus their fresh subtrees
+ * @var StaleSizesVisitor::visited - stale nodes visited so far
+ */
+template <typename Node>
+struct StaleSizesVisitor : TreeVisitor
+{
+    bool   update;
+    size_t count;
+    size_t visited;
+
+    bool Descend(Node* child, size_t)
+    {
+        return child->nodeCount == TREE_SIZE_STALE;
+    }
+
+    Error Enter(Node* node, size_t)
+    {
+        this->count++;
+        this->visited++;
+
+        if (node->left && node->left->nodeCount != TREE_SIZE_STALE)
+            this->count += node->left->nodeCount;
+        if (node->right && node->right->nodeCount != TREE_SIZE_STALE)
+            this->count += node->right->nodeCount;
+
+        return Error();
+    }
+
+    Error Leave(Node* node, size_t)
+    {
+        if (!this->update)
+            return Error();
+
+        node->nodeCount = 1;
+        if (node->left)
+            node->nodeCount += node->left->nodeCount;
+        if (node->right)
+            node->nodeCount += node->right->nodeCount;
+
+        return Error();
+    }
+};
+
+/**
+ * @brief Brings the stale sizes in the subtree up to date, visits only stale nodes
+ */
+template <typename Node>
+static TreeNodeCountResult _updateSizes(Node* node)
+{
+    SoftAssertResult(node, SIZET_POISON, ERROR_NULLPTR);
+
+    if (node->nodeCount != TREE_SIZE_STALE)
+        return { node->nodeCount, Error() };
+
+    uint64_t start = TreeStatsStart();
+
+    StaleSizesVisitor<Node> visitor = {};
+    visitor.update = true;
+
+    Error error = TreeWalk(node, visitor);
+
+    TreeStatsEnd(TREE_STATS_UPDATE_SIZES, start);
+    TreeStatsAdd(TREE_STATS_UPDATE_SIZES, visitor.visited, 0);
+
+    if (error)
+        return { SIZET_POISON, error };
+
+    return { node->nodeCount, Error() };
+}
+
+/**
+ * @brief Size of the subtree counted the same way as @ref _updateSizes, but nothing is written
+ */
+template <typename Node>
+static TreeNodeCountResult _peekSize(Node* node)
+{
+    SoftAssertResult(node, SIZET_POISON, ERROR_NULLPTR);
+
+    if (node->nodeCount != TREE_SIZE_STALE)
+        return { node->nodeCount, Error() };
+
+    StaleSizesVisitor<Node> visitor = {};
+    visitor.update = false;
+
+    Error error = TreeWalk(node, visitor);
+    if (error)
+        return { SIZET_POISON, error };
+
+    return { visitor.count, Error() };
+}
+#endif
+
+template <typename T, typename Traits>
+Error BasicTree<T, Traits>::Init(Node* root)
+{
+    SoftAssert(root, ERROR_NULLPTR);
+
+    this->root         = root;
+    this->pool         = nullptr;
+    this->verifyPolicy = TREE_VERIFY_DEFAULT;
+    this->maxSize      = 0;
+
+    return Error();
+}
+
+template <typename T, typename Traits>
+Error BasicTree<T, Traits>::Init()
+{
+    typename Node::Result rootRes = Node::New(Traits::POISON, nullptr, nullptr);
+    RETURN_ERROR(rootRes.error);
+
+    this->root         = rootRes.value;
+    this->pool         = nullptr;
+    this->verifyPolicy = TREE_VERIFY_DEFAULT;
+    this->maxSize      = 0;
+
+    return Error();
+}
+
+template <typename T, typename Traits>
+Error BasicTree<T, Traits>::InitPooled()
+{
+    Pool* pool = nullptr;
+    RETURN_ERROR(_newPool(&pool));
+
+    typename Node::Result rootRes = Node::New(Traits::POISON, nullptr, nullptr, pool);
+    if (rootRes.error)
+    {
+        _deletePool(pool);
+        return rootRes.error;
+    }
+
+    RETURN_ERROR(this->Init(rootRes.value));
+    this->pool = pool;
+
+    return Error();
+}
+
+template <typename Pool>
+static Error _newPool(Pool** pool)
+{
+    SoftAssert(pool, ERROR_NULLPTR);
+
+    *pool = (Pool*)calloc(1, sizeof(Pool));
+    if (!*pool)
+        return CREATE_ERROR(ERROR_NO_MEMORY);
+
+    return (*pool)->Init();
+}
+
+template <typename Pool>
+static void _deletePool(Pool* pool)
+{
+    if (!pool)
+        return;
+
+    pool->Destructor();
+    free(pool);
+}
+
+template <typename T, typename Traits>
+Error BasicTree<T, Traits>::Destructor()
+{
+    ERR_DUMP_RET(this);
+
+    #ifndef NDEBUG
+    // freeing the pool skips the nodes one by one, so they leave the log here
+    if (this->pool)
+        _unmarkTree(this);
+    #endif
+
+    if (this->pool)
+        _deletePool(this->pool);
+    else
+        RETURN_ERROR(this->root->Delete());
+
+    this->root = nullptr;
+    this->pool = nullptr;
+    
+    return Error();
+}
+
+template <typename T, typename Traits>
+Error BasicTree<T, Traits>::Verify() const
+{
+    uint64_t start = TreeStatsStart();
+    Error    error = _verifyByPolicy(this);
+    TreeStatsEnd(TREE_STATS_VERIFY, start);
+
+    return error;
+}
+
+template <typename T, typename Traits>
+Error BasicTree<T, Traits>::VerifyFull() const
+{
+    uint64_t start = TreeStatsStart();
+    Error    error = _verifyFull(this);
+    TreeStatsEnd(TREE_STATS_VERIFY_FULL, start);
+
+    return error;
+}
+
+template <typename Tree>
+static Error _verifyByPolicy(const Tree* tree)
+{
+    if (!tree->root)
+        return CREATE_ERROR(ERROR_NO_ROOT);
+
+    if (tree->root->parent)
+        return CREATE_ERROR(ERROR_TREE_LOOP);
+
+    #ifndef NDEBUG
+    static std::atomic<size_t> VERIFY_CALLS(0);
+
+    TreeVerifyPolicy policy = tree->verifyPolicy;
+    if (policy == TREE_VERIFY_DEFAULT)
+        policy = TREE_VERIFY_POLICY;
+
+    // a tree checked incrementally before keeps logging its changes until it is checked another way
+    if (policy != TREE_VERIFY_INCREMENTAL)
+        _unmarkTree(tree);
+
+    switch (policy)
+    {
+        case TREE_VERIFY_OFF:
+            return Error();
+        case TREE_VERIFY_SAMPLED:
+            if (VERIFY_CALLS.fetch_add(1, std::memory_order_relaxed) % TREE_VERIFY_SAMPLE_PERIOD)
+                return Error();
+            return tree->VerifyFull();
+        case TREE_VERIFY_INCREMENTAL:
+            if (tree->maxSize)
+            {
+                TreeNodeCountResult sizeRes = tree->Size();
+                RETURN_ERROR(sizeRes.error);
+
+                if (sizeRes.value > tree->maxSize)
+                    return CREATE_ERROR(ERROR_BAD_SIZE);
+            }
+
+            return _verifyIncremental(tree);
+        case TREE_VERIFY_DEFAULT:
+        case TREE_VERIFY_FULL:
+        default:
+            return tree->VerifyFull();
+    }
+    #endif
+
+    return Error();
+}
+
+template <typename Tree>
+static Error _verifyFull(const Tree* tree)
+{
+    if (!tree->root)
+        return CREATE_ERROR(ERROR_NO_ROOT);
+
+    if (tree->root->parent)
+        return CREATE_ERROR(ERROR_TREE_LOOP);
+
+    #ifndef NDEBUG
+    TreeNodeCountResult sizeRes = tree->Size();
+    RETURN_ERROR(sizeRes.error);
+
+    if (tree->maxSize && sizeRes.value > tree->maxSize)
+        return CREATE_ERROR(ERROR_BAD_SIZE);
+
+    TreeNodeCountResult countRes = _countNodes(tree->root);
+    RETURN_ERROR(countRes.error);
+    TreeStatsAdd(TREE_STATS_VERIFY_FULL, countRes.value, 0);
+
+    if (countRes.value != sizeRes.value)
+        return CREATE_ERROR(ERROR_BAD_TREE);
+    #endif
+
+    return Error();
+}
+
+#ifndef NDEBUG
+/**
+ * @brief Checks the nodes logged since the last check, the first check of the
+ * tree checks it all and marks its nodes
+ */
+template <typename Tree>
+static Error _verifyIncremental(const Tree* tree)
+{
+    typedef typename Tree::Node Node;
+
+    Node*                 root = tree->root;
+    TreeTouchedLog<Node>* log  = __atomic_load_n(&root->touchedLog, __ATOMIC_ACQUIRE);
+
+    // the root may still be marked by a tree it was taken from
+    if (!log || log->root.load() != root)
+        return _markTree(tree, log);
+
+    // checking empties the log, so readers of the same tree take turns here
+    pthread_mutex_lock(&log->mutex);
+
+    Error error = Error();
+    if (!log->lost)
+        error = _verifyTouched(log);
+    else
+    {
+        error = tree->VerifyFull();
+        if (!error)
+            error = _markNodes(root, log);
+        if (!error)
+            _clearTouched(log);
+    }
+
+    pthread_mutex_unlock(&log->mutex);
+
+    return error;
+}
+
+/**
+ * @brief Makes the log of the tree and marks every node with it after a full check
+ *
+ * Readers of the tree may get here together, the one which puts its log on the
+ * root does the work and the others wait for it on the log.
+ */
+template <typename Tree>
+static Error _markTree(const Tree* tree, TreeTouchedLog<typename Tree::Node>* old)
+{
+    typedef typename Tree::Node Node;
+
+    Node*                 root = tree->root;
+    TreeTouchedLog<Node>* log  = _newTouchedLog(root);
+    if (!log)
+        return tree->VerifyFull();
+
+    pthread_mutex_lock(&log->mutex);
+
+    if (!__atomic_compare_exchange_n(&root->touchedLog, &old, log, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+        pthread_mutex_unlock(&log->mutex);
+        _releaseTouchedLog(log);
+        return _verifyIncremental(tree);
+    }
+
+    if (old)
+        _leave(root, old);
+
+    // a broken tree is marked once a full check passes, till then every check is full
+    Error error = tree->VerifyFull();
+    if (!error)
+        error = _markNodes(root, log);
+
+    log->lost = error;
+
+    pthread_mutex_unlock(&log->mutex);
+
+    return error;
+}
+
+/**
+ * @brief Takes the nodes of the tree out of their logs, if the root is marked
+ */
+template <typename Tree>
+static void _unmarkTree(const Tree* tree)
+{
+    typedef typename Tree::Node Node;
+
+    Node*                 root = tree->root;
+    TreeTouchedLog<Node>* log  = __atomic_load_n(&root->touchedLog, __ATOMIC_ACQUIRE);
+
+    // another reader may be unmarking the tree already
+    if (!log || !__atomic_compare_exchange_n(&root->touchedLog, &log, nullptr, false, __ATOMIC_ACQ_REL,
+                                             __ATOMIC_ACQUIRE))
+        return;
+
+    _leave(root, log);
+
+    // a broken tree is left marked, the walk stops at the loop
+    TreePreOrder(root, [](Node* node, size_t)
+    {
+        _unmark(node);
+        return Error();
+    });
+}
+
+/**
+ * @brief Marks the nodes of a checked tree with log, under the mutex of log
+ */
+template <typename Node>
+static Error _markNodes(Node* root, TreeTouchedLog<Node>* log)
+{
+    return TreePreOrder(root, [log](Node* node, size_t)
+    {
+        if (node->touchedLog != log)
+        {
+            _unmark(node);
+            node->touchedLog = log;
+            log->refs++;
+        }
+
+        return Error();
+    });
+}
+
+/**
+ * @brief Logs a change to node, if it is marked
+ */
+template <typename Node>
+static void _touch(Node* node)
+{
+    TreeTouchedLog<Node>* log = node->touchedLog;
+    if (!log)
+        return;
+
+    pthread_mutex_lock(&log->mutex);
+    _addTouched(log, node);
+    pthread_mutex_unlock(&log->mutex);
+}
+
+/** @struct TouchedMarkVisitor
+ * @brief Marks a subtree linked into a marked tree, stops at the nodes marked already
+ */
+template <typename Node>
+struct TouchedMarkVisitor : TreeVisitor
+{
+    TreeTouchedLog<Node>* log;
+
+    bool Descend(Node* child, size_t)
+    {
+        return child->touchedLog != this->log;
+    }
+
+    Error Enter(Node* node, size_t)
+    {
+        if (node->touchedLog != this->log)
+        {
+            _unmark(node);
+            node->touchedLog = this->log;
+            this->log->refs++;
+        }
+
+        _touch(node);
+
+        return Error();
+    }
+};
+
+/**
+ * @brief Marks node and its subtree with log and logs them, a subtree already in
+ * the tree costs O(1)
+ */
+template <typename Node>
+static void _mark(Node* node, TreeTouchedLog<Node>* log)
+{
+    TouchedMarkVisitor<Node> visitor = {};
+    visitor.log = log;
+
+    TreeWalk(node, visitor);
+}
+
+/**
+ * @brief Takes node out of its log, on delete or when it is marked again
+ */
+template <typename Node>
+static void _unmark(Node* node)
+{
+    TreeTouchedLog<Node>* log = node->touchedLog;
+    if (!log)
+        return;
+
+    node->touchedLog = nullptr;
+    _leave(node, log);
+}
+
+/**
+ * @brief Takes node out of the entries and the references of log, which
+ * node is no longer marked with
+ */
+template <typename Node>
+static void _leave(Node* node, TreeTouchedLog<Node>* log)
+{
+    pthread_mutex_lock(&log->mutex);
+
+    if (node->touchedIndex)
+    {
+        Node* last = log->nodes[--log->count];
+
+        log->nodes[node->touchedIndex - 1] = last;
+        last->touchedIndex = node->touchedIndex;
+        node->touchedIndex = 0;
+    }
+
+    if (log->root.load() == node)
+        log->root = nullptr;
+
+    pthread_mutex_unlock(&log->mutex);
+
+    _releaseTouchedLog(log);
+}
+
+/**
+ * @brief Makes an empty log for the tree of root, which holds its first reference,
+ * nullptr if out of memory
+ */
+template <typename Node>
+static TreeTouchedLog<Node>* _newTouchedLog(Node* root)
+{
+    TreeTouchedLog<Node>* log = (TreeTouchedLog<Node>*)calloc(1, sizeof(*log));
+    if (!log)
+        return nullptr;
+
+    if (pthread_mutex_init(&log->mutex, nullptr))
+    {
+        free(log);
+        return nullptr;
+    }
+
+    log->root = root;
+    log->refs = 1;
+
+    return log;
+}
+
+template <typename Node>
+static void _releaseTouchedLog(TreeTouchedLog<Node>* log)
+{
+    if (log->refs.fetch_sub(1) != 1)
+        return;
+
+    pthread_mutex_destroy(&log->mutex);
+    free(log->nodes);
+    free(log);
+}
+
+/**
+ * @brief Puts node in log unless it is there, under the mutex of log
+ */
+template <typename Node>
+static void _addTouched(TreeTouchedLog<Node>* log, Node* node)
+{
+    if (node->touchedIndex || log->lost)
+        return;
+
+    if (log->count == log->capacity)
+    {
+        size_t newCapacity = max(2 * log->capacity, (size_t)64);
+        Node** newNodes    = nullptr;
+
+        if (newCapacity <= TREE_VERIFY_MAX_TOUCHED)
+            newNodes = (Node**)realloc(log->nodes, newCapacity * sizeof(*newNodes));
+
+        // too much was touched to remember, the next incremental check is full
+        if (!newNodes)
+        {
+            _clearTouched(log);
+            log->lost = true;
+            return;
+        }
+
+        log->nodes    = newNodes;
+        log->capacity = newCapacity;
+    }
+
+    log->nodes[log->count++] = node;
+    node->touchedIndex = log->count;
+}
+
+/**
+ * @brief Empties log, the nodes stay marked
+ */
+template <typename Node>
+static void _clearTouched(TreeTouchedLog<Node>* log)
+{
+    for (size_t i = 0; i < log->count; i++)
+        log->nodes[i]->touchedIndex = 0;
+
+    log->count = 0;
+    log->lost  = false;
+}
+
+template <typename Node>
+static Error _verifyNode(Node* node)
+{
+    Node* left   = node->left;
+    Node* right  = node->right;
+    Node* parent = node->parent;
+
+    if (left && (left->parent != node || left == right))
+        return CREATE_ERROR(ERROR_TREE_LOOP);
+    if (right && right->parent != node)
+        return CREATE_ERROR(ERROR_TREE_LOOP);
+    if (parent && parent->left != node && parent->right != node)
+        return CREATE_ERROR(ERROR_TREE_LOOP);
+
+    // ancestors of a stale node are stale, so a fresh node has fresh children
+    if (node->nodeCount == TREE_SIZE_STALE)
+    {
+        if (parent && parent->nodeCount != TREE_SIZE_STALE)
+            return CREATE_ERROR(ERROR_BAD_TREE);
+        return Error();
+    }
+
+    size_t count = 1;
+    if (left)
+    {
+        if (left->nodeCount == TREE_SIZE_STALE)
+            return CREATE_ERROR(ERROR_BAD_TREE);
+        count += left->nodeCount;
+    }
+    if (right)
+    {
+        if (right->nodeCount == TREE_SIZE_STALE)
+            return CREATE_ERROR(ERROR_BAD_TREE);
+        count += right->nodeCount;
+    }
+
+    if (count != node->nodeCount)
+        return CREATE_ERROR(ERROR_BAD_TREE);
+
+    return Error();
+}
+
+template <typename Node>
+static Error _verifyTouched(TreeTouchedLog<Node>* log)
+{
+    for (size_t i = 0; i < log->count; i++)
+        RETURN_ERROR(_verifyNode(log->nodes[i]));
+
+    _clearTouched(log);
+
+    return Error();
+}
+#endif
+
+template <typename T, typename Traits>
+TreeNodeCountResult BasicTree<T, Traits>::CountNodes() const
+{
+    ERR_DUMP_RET_RESULT(this, SIZET_POISON);
+
+    return _countNodes(this->root);
+}
+
+template <typename T, typename Traits>
+TreeNodeCountResult BasicTree<T, Traits>::CountNodes(size_t threads) const
+{
+    ERR_DUMP_RET_RESULT(this, SIZET_POISON);
+
+    if (threads == 0)
+        threads = TreeParallelThreads();
+
+    if (threads == 1 || _isSmall(this->root))
+        return _countNodes(this->root);
+
+    Node** tasks      = nullptr;
+    size_t tasksCount = 0;
+    size_t spineCount = 0;
+
+    Error error = _split(this->root, _splitDepth<Node>(threads), &tasks, &tasksCount, &spineCount);
+
+    size_t* counts = nullptr;
+    if (!error)
+    {
+        counts = (size_t*)calloc(tasksCount, sizeof(*counts));
+        if (!counts)
+            error = CREATE_ERROR(ERROR_NO_MEMORY);
+    }
+
+    if (!error)
+        error = TreeParallelFor(tasksCount, threads, [tasks, counts](size_t task, size_t)
+        {
+            TreeNodeCountResult countRes = _countNodes(tasks[task]);
+            counts[task] = countRes.value;
+
+            return countRes.error;
+        });
+
+    size_t count = spineCount;
+    for (size_t task = 0; task < tasksCount && !error; task++)
+        count += counts[task];
+
+    free(tasks);
+    free(counts);
+
+    if (error)
+        return { SIZET_POISON, error };
+
+    return { count, Error() };
+}
+
+template <typename Node>
+static TreeNodeCountResult _countNodes(Node* node)
+{
+    SoftAssertResult(node, SIZET_POISON, ERROR_NULLPTR);
+
+    uint64_t start = TreeStatsStart();
+    size_t   count = 0;
+
+    Error error = TreePreOrder(node, [&count](Node*, size_t)
+    {
+        count++;
+        return Error();
+    });
+
+    TreeStatsEnd(TREE_STATS_COUNT_NODES, start);
+    TreeStatsAdd(TREE_STATS_COUNT_NODES, count, 0);
+
+    if (error)
+        return { SIZET_POISON, error };
+
+    return { count, Error() };
+}
+
+#ifdef TREE_SUBTREE_SIZES
+template <typename T, typename Traits>
+Error BasicTree<T, Traits>::RecalculateNodes()
+{
+    ERR_DUMP_RET(this);
+
+    return _recalcNodes(this->root);
+}
+
+template <typename T, typename Traits>
+TreeNodeCountResult BasicTree<T, Traits>::Size() const
+{
+    SoftAssertResult(this->root, SIZET_POISON, ERROR_NO_ROOT);
+
+    return _peekSize(this->root);
+}
+
+template <typename T, typename Traits>
+TreeNodeCountResult BasicTree<T, Traits>::UpdateSizes()
+{
+    SoftAssertResult(this->root, SIZET_POISON, ERROR_NO_ROOT);
+
+    return _updateSizes(this->root);
+}
+
+template <typename T, typename Traits>
+typename BasicTree<T, Traits>::Node::Result BasicTree<T, Traits>::Select(size_t index)
+{
+    ERR_DUMP_RET_RESULT(this, nullptr);
+
+    TreeNodeCountResult sizeRes = _updateSizes(this->root);
+    if (sizeRes.error)
+        return { nullptr, sizeRes.error };
+
+    if (index >= sizeRes.value)
+        return { nullptr, CREATE_ERROR(ERROR_BAD_SIZE) };
+
+    // sizes below the root are fresh now, the left subtree size says where to go
+    Node* node = this->root;
+    while (true)
+    {
+        size_t leftSize = node->left ? node->left->nodeCount : 0;
+
+        if (index == leftSize)
+            return { node, Error() };
+
+        if (index < leftSize)
+            node = node->left;
+        else
+        {
+            index -= leftSize + 1;
+            node   = node->right;
+        }
+    }
+}
+
+template <typename T, typename Traits>
+TreeNodeCountResult BasicTree<T, Traits>::Rank(Node* node)
+{
+    SoftAssertResult(node, SIZET_POISON, ERROR_NULLPTR);
+    ERR_DUMP_RET_RESULT(this, SIZET_POISON);
+
+    TreeNodeCountResult sizeRes = _updateSizes(this->root);
+    RETURN_RESULT(sizeRes);
+
+    size_t rank  = node->left ? node->left->nodeCount : 0;
+    size_t steps = 0;
+
+    // a node of the tree reaches the root in fewer steps than the tree has nodes
+    for (Node* child = node; child != this->root; child = child->parent)
+    {
+        Node* parent = child->parent;
+        if (!parent || steps++ == sizeRes.value)
+            return { SIZET_POISON, CREATE_ERROR(ERROR_BAD_TREE) };
+
+        if (parent->right == child)
+            rank += 1 + (parent->left ? parent->left->nodeCount : 0);
+        else if (parent->left != child)
+            return { SIZET_POISON, CREATE_ERROR(ERROR_TREE_LOOP) };
+    }
+
+    return { rank, Error() };
+}
+
+template <typename Node>
+static Error _recalcNodes(Node* node)
+{
+    SoftAssert(node, ERROR_NULLPTR);
+
+    return TreePostOrder(node, [](Node* node, size_t)
+    {
+        node->nodeCount = 1;
+
+        if (node->left)
+            node->nodeCount += node->left->nodeCount;
+        if (node->right)
+            node->nodeCount += node->right->nodeCount;
+
+        return Error();
+    });
+}
+#endif
+
+template <typename T, typename Traits>
+Error BasicTree<T, Traits>::Dump() const
+{
+    SoftAssert(this->root, ERROR_NO_ROOT);
+
+    size_t MAX_DEPTH = TREE_DUMP_MAX_DEPTH;
+    #ifdef TREE_SUBTREE_SIZES
+    TreeNodeCountResult sizeRes = this->Size();
+    if (!sizeRes.error)
+        MAX_DEPTH = min(sizeRes.value, TREE_DUMP_MAX_DEPTH);
+    #endif
+
+    TreeDumpOptions options = {};
+    options.maxDepth = MAX_DEPTH;
+    options.maxNodes = TREE_DUMP_MAX_NODES;
+    options.compact  = false;
+
+    return this->Dump(nullptr, &options);
+}
+
+template <typename T, typename Traits>
+Error BasicTree<T, Traits>::Dump(Node* subtree, const TreeDumpOptions* options) const
+{
+    SoftAssert(this->root, ERROR_NO_ROOT);
+    SoftAssert(options,    ERROR_NULLPTR);
+
+    uint64_t start     = TreeStatsStart();
+    size_t   iteration = DUMP_ITERATION.fetch_add(1, std::memory_order_relaxed);
+
+    size_t treeSize = 0;
+    #ifdef TREE_SUBTREE_SIZES
+    TreeNodeCountResult sizeRes = this->Size();
+    if (!sizeRes.error)
+        treeSize = sizeRes.value;
+    #endif
+
+    // the snapshot already costs the caller O(nodes), so checks which are off or sampled are skipped here
+    TreeVerifyPolicy policy = this->verifyPolicy;
+    if (policy == TREE_VERIFY_DEFAULT)
+        policy = TREE_VERIFY_POLICY;
+
+    const char* errorName = "not checked";
+    if (policy != TREE_VERIFY_OFF && policy != TREE_VERIFY_SAMPLED)
+        errorName = this->Verify().GetErrorName();
+
+    Error        error = Error();
+    TreeDumpJob* job   = (TreeDumpJob*)calloc(1, sizeof(*job));
+    if (!job)
+        error = CREATE_ERROR(ERROR_NO_MEMORY);
+
+    if (!error)
+    {
+        job->logFolder = LOG_FOLDER;
+        job->iteration = iteration;
+        job->errorName = errorName;
+        job->treeSize  = treeSize;
+
+        error = job->Init(subtree ? subtree : this->root, options);
+
+        // the worker owns the job once it is submitted
+        TreeStatsAdd(TREE_STATS_DUMP, job->nodesCount, 0);
+        if (!error)
+            error = job->Submit();
+
+        if (error)
+        {
+            job->Destructor();
+            free(job);
+        }
+    }
+
+    // the heading and the picture of one dump stay together when several threads dump
+    if (HTML_FILE)
+    {
+        flockfile(HTML_FILE);
+
+        fprintf(HTML_FILE, 
+        "<h1>Iteration %zu</h1>\n"
+        "<style>\n"
+        ".content {\n"
+        "max-width: 500px;\n"
+        "margin: auto;\n"
+        "}\n"
+        "</style>,\n",
+        iteration);
+
+        if (error)
+            fprintf(HTML_FILE, "<p>Not drawn: %s</p>\n", error.GetErrorName());
+        else
+            fprintf(HTML_FILE, "<img src = \"%s/img/Iteration%zu.png\"/>\n", LOG_FOLDER, iteration);
+
+        funlockfile(HTML_FILE);
+    }
+
+    TreeStatsEnd(TREE_STATS_DUMP, start);
+
+    return error;
+}
+
+template <typename T, typename Traits>
+Error BasicTree<T, Traits>::Print(const char* outPath) const
+{
+    SoftAssert(outPath, ERROR_NULLPTR);
+    ERR_DUMP_RET(this);
+
+    int fd = open(outPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return CREATE_ERROR(ERROR_BAD_FILE);
+
+    uint64_t start = TreeStatsStart();
+
+    TreeTextWriter writer = {};
+    Error error = writer.Init(fd);
+
+    if (!error)
+        error = _print(this->root, &writer);
+    if (!error)
+        error = writer.Flush();
+
+    writer.Destructor();
+
+    off_t bytes = lseek(fd, 0, SEEK_CUR);
+    if (close(fd) != 0 && !error)
+        error = CREATE_ERROR(ERROR_BAD_FILE);
+
+    TreeStatsEnd(TREE_STATS_PRINT, start);
+    TreeStatsAdd(TREE_STATS_PRINT, 0, bytes > 0 ? (uint64_t)bytes : 0);
+
+    return error;
+}
+
+template <typename T, typename Traits>
+TreeBufferResult BasicTree<T, Traits>::PrintToBuffer() const
+{
+    ERR_DUMP_RET_RESULT(this, {});
+
+    uint64_t start = TreeStatsStart();
+
+    TreeTextWriter writer = {};
+    Error error = writer.Init(-1);
+
+    if (!error)
+        error = _print(this->root, &writer);
+
+    TreeStatsEnd(TREE_STATS_PRINT, start);
+    TreeStatsAdd(TREE_STATS_PRINT, 0, writer.size);
+
+    if (error)
+    {
+        writer.Destructor();
+        return { {}, error };
+    }
+
+    // the buffer is handed to the caller as it is
+    return { { writer.buffer, writer.size }, Error() };
+}
+
+template <typename Node>
+static Error _print(Node* node, TreeTextWriter* writer)
+{
+    SoftAssert(node, ERROR_NULLPTR);
+    SoftAssert(writer, ERROR_NULLPTR);
+
+    struct : TreeVisitor
+    {
+        TreeTextWriter* writer;
+        const char*     separator;
+        size_t          separatorLength;
+        size_t          nodes;
+
+        Error Enter(Node* node, size_t)
+        {
+            this->nodes++;
+
+            RETURN_ERROR(this->writer->Write("(", 1));
+            RETURN_ERROR(this->writer->Write(this->separator, this->separatorLength));
+            RETURN_ERROR(this->writer->WriteElement<typename Node::ElementTraits>(node->value));
+            RETURN_ERROR(this->writer->Write(this->separator, this->separatorLength));
+
+            if (!node->left)
+                return this->WriteNil();
+
+            return Error();
+        }
+
+        Error Between(Node* node, size_t)
+        {
+            if (!node->right)
+                return this->WriteNil();
+
+            return Error();
+        }
+
+        Error Leave(Node*, size_t)
+        {
+            RETURN_ERROR(this->writer->Write(")", 1));
+            return this->writer->Write(this->separator, this->separatorLength);
+        }
+
+        Error WriteNil()
+        {
+            RETURN_ERROR(this->writer->Write("nil", 3));
+            return this->writer->Write(this->separator, this->separatorLength);
+        }
+    } visitor;
+    visitor.writer          = writer;
+    visitor.separator       = TREE_WORD_SEPARATOR;
+    visitor.separatorLength = strlen(TREE_WORD_SEPARATOR);
+    visitor.nodes           = 0;
+
+    Error error = TreeWalk(node, visitor);
+    TreeStatsAdd(TREE_STATS_PRINT, visitor.nodes, 0);
+
+    return error;
+}
 
-    return Error();
+/** @struct SortedRange
+ * @brief Values [begin, end) still to be built into a subtree of parent
+ *
+ * @var SortedRange::isLeft - whether the subtree is the left child of parent
+ * @var SortedRange::depth - depth of the subtree's root
+ * @var SortedRange::root - the subtree once a thread has built it
+ */
+template <typename Node>
+struct SortedRange
+{
+    size_t begin;
+    size_t end;
+    Node*  parent;
+    bool   isLeft;
+    size_t depth;
+    Node*  root;
+};
+
+template <typename T, typename Traits>
+Error BasicTree<T, Traits>::BuildFromSorted(const T* values, size_t count)
+{
+    return this->BuildFromSorted(values, count, 1);
 }
 
-Error TreeNode::SetRight(TreeNode* right)
+template <typename T, typename Traits>
+Error BasicTree<T, Traits>::BuildFromSorted(const T* values, size_t count, size_t threads)
 {
-    SoftAssert(right, ERROR_NULLPTR);
+    SoftAssert(values, ERROR_NULLPTR);
 
-    #ifndef NDEBUG
-    this->nodeCount += right->nodeCount;
-    if (this->right)
-        this->nodeCount -= this->right->nodeCount;
-    #endif
-    this->right = right;
-    right->parent = this;
+    if (count == 0)
+        return CREATE_ERROR(ERROR_BAD_SIZE);
 
-    #ifndef NDEBUG
-    if (this->parent)
-        return _recUpdateParentNodeCount(this->parent, right->nodeCount);
-    #endif
+    if (threads == 0)
+        threads = TreeParallelThreads();
 
-    return Error();
-}
+    Pool* pool = nullptr;
+    RETURN_ERROR(_newPool(&pool));
 
-static TreeNodeResult _recCopy(TreeNode* node)
-{
-    SoftAssertResult(node, nullptr, ERROR_NULLPTR);
-    if (node->id == BAD_ID)
-        return { nullptr, CREATE_ERROR(ERROR_TREE_LOOP) };
-    
-    size_t oldId = node->id;
-    node->id = BAD_ID;
+    size_t             splitDepth = SIZE_MAX;
+    SortedRange<Node>* tasks      = nullptr;
+    size_t             tasksCount = 0;
 
-    TreeNodeResult leftChild = { nullptr, Error() };
-    if (node->left)
+    if (threads > 1 && count >= TREE_PARALLEL_CUTOFF)
     {
-        if (node->left->parent != node)
-            return { nullptr, CREATE_ERROR(ERROR_TREE_LOOP) };
-        leftChild = _recCopy(node->left);
-    }
-    RETURN_RESULT(leftChild);
-
-    TreeNodeResult rightChild = { nullptr, Error() };
+        splitDepth = _splitDepth<Node>(threads);
 
-    if (node->right)
-    {
-        if (node->right->parent != node)
+        tasks = (SortedRange<Node>*)calloc((size_t)1 << splitDepth, sizeof(*tasks));
+        if (!tasks)
         {
-            leftChild.value->Delete();
-            return { nullptr, CREATE_ERROR(ERROR_TREE_LOOP) };
+            _deletePool(pool);
+            return CREATE_ERROR(ERROR_NO_MEMORY);
         }
-        rightChild = _recCopy(node->right);
-    }
-    if (rightChild.error)
-    {
-        leftChild.value->Delete();
-        return { nullptr, rightChild.error };
     }
 
-    TreeNodeResult copy = TreeNode::New(node->value, leftChild.value, rightChild.value);
+    SortedRange<Node>     whole   = { 0, count, nullptr, false, 0, nullptr };
+    typename Node::Result rootRes = _buildSorted(values, whole, pool, splitDepth, tasks, &tasksCount);
 
-    if (copy.error)
+    if (!rootRes.error && tasksCount)
     {
-        leftChild.value->Delete();
-        rightChild.value->Delete();
+        Pool threadPools[TREE_PARALLEL_MAX_THREADS] = {};
+        for (size_t thread = 0; thread < threads && thread < TREE_PARALLEL_MAX_THREADS; thread++)
+            threadPools[thread].Init();
 
-        return { nullptr, copy.error };
-    }
+        rootRes.error = TreeParallelFor(tasksCount, threads, [values, tasks, &threadPools](size_t task, size_t thread)
+        {
+            SortedRange<Node> range = tasks[task];
+            range.parent = nullptr;
 
-    node->id = oldId;
+            typename Node::Result subtreeRes = _buildSorted(values, range, &threadPools[thread], SIZE_MAX,
+                                                            (SortedRange<Node>*)nullptr, nullptr);
+            tasks[task].root = subtreeRes.value;
 
-    return copy;
-}
+            return subtreeRes.error;
+        });
 
-#ifndef NDEBUG
-static Error _recUpdateParentNodeCount(TreeNode* node, ssize_t change)
-{
-    SoftAssert(node, ERROR_NULLPTR);
-    if (node->id == BAD_ID)
-        return CREATE_ERROR(ERROR_TREE_LOOP);
+        for (size_t task = 0; task < tasksCount; task++)
+        {
+            Node* subtree = tasks[task].root;
+            if (!subtree)
+                continue;
+
+            if (tasks[task].isLeft)
+                tasks[task].parent->left  = subtree;
+            else
+                tasks[task].parent->right = subtree;
+            subtree->parent = tasks[task].parent;
+        }
 
-    size_t oldId = node->id;
-    node->id = BAD_ID;
+        for (size_t thread = 0; thread < threads && thread < TREE_PARALLEL_MAX_THREADS; thread++)
+            pool->Merge(&threadPools[thread]);
+    }
 
-    node->nodeCount += change;
+    free(tasks);
 
-    if (node->parent)
+    if (rootRes.error)
     {
-        if (node->parent->left != node && node->parent->right != node)
-            return CREATE_ERROR(ERROR_TREE_LOOP);
-        RETURN_ERROR(_recUpdateParentNodeCount(node->parent, change));
+        _deletePool(pool);
+        return rootRes.error;
     }
 
-    node->id = oldId;
+    this->root = rootRes.value;
+    this->pool = pool;
 
     return Error();
 }
-#endif
 
-Error Tree::Init(TreeNode* root)
+/**
+ * @brief Builds range with its middle value on top, ranges reaching splitDepth
+ * are put to tasks instead, their parents already know their sizes
+ *
+ * Ranges wait on a stack with the right half under the left one, so nodes are cut
+ * in pre-order. The stack never holds more than two ranges per level.
+ */
+template <typename Node>
+static typename Node::Result _buildSorted(const typename Node::Element* values, SortedRange<Node> range,
+                                          typename Node::Pool* pool, size_t splitDepth,
+                                          SortedRange<Node>* tasks, size_t* tasksCount)
 {
-    SoftAssert(root, ERROR_NULLPTR);
+    SortedRange<Node> stack[2 * sizeof(size_t) * 8] = {};
+    size_t            stackSize = 0;
+    Node*             root      = nullptr;
 
-    this->root = root;
-    #ifndef NDEBUG
-    this->size = &root->nodeCount;
-    #endif
+    stack[stackSize++] = range;
 
-    return Error();
-}
+    while (stackSize)
+    {
+        SortedRange<Node> top = stack[--stackSize];
+        if (top.begin == top.end)
+            continue;
 
-Error Tree::Init()
-{
-    TreeNodeResult rootRes = TreeNode::New(TREE_POISON, nullptr, nullptr);
-    RETURN_ERROR(rootRes.error);
+        if (top.depth == splitDepth)
+        {
+            tasks[(*tasksCount)++] = top;
+            continue;
+        }
 
-    this->root = rootRes.value;
-    #ifndef NDEBUG
-    this->size = &rootRes.value->nodeCount;
-    #endif
+        size_t middle = top.begin + (top.end - top.begin) / 2;
 
-    return Error();
-}
+        typename Node::Result nodeRes = Node::New(values[middle], nullptr, nullptr, pool);
+        if (nodeRes.error)
+            return { nullptr, nodeRes.error };
 
-Error Tree::Destructor()
-{
-    ERR_DUMP_RET(this);
+        Node* node = nodeRes.value;
+
+        #ifdef TREE_SUBTREE_SIZES
+        node->nodeCount = top.end - top.begin;
+        #endif
 
-    RETURN_ERROR(this->root->Delete());
+        if (!top.parent)
+            root = node;
+        else if (top.isLeft)
+            top.parent->left  = node;
+        else
+            top.parent->right = node;
+        node->parent = top.parent;
 
-    this->root = nullptr;
-    #ifndef NDEBUG
-    this->size = nullptr;
-    #endif
-    
-    return Error();
+        stack[stackSize++] = { middle + 1, top.end, node, false, top.depth + 1, nullptr };
+        stack[stackSize++] = { top.begin,  middle,  node, true,  top.depth + 1, nullptr };
+    }
+
+    return { root, Error() };
 }
 
-Error Tree::Verify()
+template <typename T, typename Traits>
+Error BasicTree<T, Traits>::Read(const char* readPath)
 {
-    if (!this->root)
-        return CREATE_ERROR(ERROR_NO_ROOT);
+    SoftAssert(readPath, ERROR_NULLPTR);
 
-    if (this->root->parent)
-        return CREATE_ERROR(ERROR_TREE_LOOP);
+    FILE* readFile = fopen(readPath, "rb");
+    if (!readFile) return CREATE_ERROR(ERROR_BAD_FILE);
 
-    #ifndef NDEBUG
-    if (*this->size > MAX_TREE_SIZE)
-        return CREATE_ERROR(ERROR_BAD_SIZE);
-    
-    TreeNodeCountResult sizeRes = _recCountNodes(this->root);
-    RETURN_ERROR(sizeRes.error);
+    Error error = this->Read(readFile);
 
-    if (sizeRes.value != *this->size)
-        return CREATE_ERROR(ERROR_BAD_TREE);
-    #endif
+    fclose(readFile);
 
-    return Error();
+    return error;
 }
 
-TreeNodeCountResult Tree::CountNodes()
+template <typename T, typename Traits>
+Error BasicTree<T, Traits>::Read(FILE* readFile)
 {
-    ERR_DUMP_RET_RESULT(this, SIZET_POISON);
+    SoftAssert(readFile, ERROR_NULLPTR);
 
-    return _recCountNodes(this->root);
-}
+    TreeTextReader reader = {};
+    RETURN_ERROR(reader.Init(readFile));
 
-static TreeNodeCountResult _recCountNodes(TreeNode* node)
-{
-    SoftAssertResult(node, SIZET_POISON, ERROR_NULLPTR);
-    if (node->id == BAD_ID)
-        return { SIZET_POISON, CREATE_ERROR(ERROR_TREE_LOOP) };
+    uint64_t start = TreeStatsStart();
 
-    size_t oldId = node->id;
-    node->id = BAD_ID;
+    Pool*                 pool    = nullptr;
+    typename Node::Result rootRes = { nullptr, _newPool(&pool) };
 
-    size_t count = 1;
+    if (!rootRes.error)
+        rootRes = _read<Node>(&reader, pool);
 
-    TreeNodeCountResult countResult = {};
+    reader.Destructor();
 
-    if (node->left)
-    {
-        if (node->left->parent != node)
-            return { SIZET_POISON, CREATE_ERROR(ERROR_TREE_LOOP) };
-        countResult = _recCountNodes(node->left);
-        RETURN_RESULT(countResult);
-    }
+    TreeStatsEnd(TREE_STATS_READ, start);
+    TreeStatsAdd(TREE_STATS_READ, pool ? pool->nodesInUse : 0, 0);
 
-    count += countResult.value;
+    if (!rootRes.error && !rootRes.value)
+        rootRes.error = CREATE_ERROR(ERROR_NO_ROOT);
 
-    if (node->right)
+    if (rootRes.error)
     {
-        if (node->right->parent != node)
-            return { SIZET_POISON, CREATE_ERROR(ERROR_TREE_LOOP) };
-        countResult = _recCountNodes(node->right);
-        RETURN_RESULT(countResult);
+        _deletePool(pool);
+        return rootRes.error;
     }
 
-    count += countResult.value;
-
-    node->id = oldId;
+    this->root = rootRes.value;
+    this->pool = pool;
 
-    return { count, Error() };
+    return Error();
 }
 
-#ifndef NDEBUG
-Error Tree::RecalculateNodes()
+template <typename Node>
+static typename Node::Result _read(TreeTextReader* reader, typename Node::Pool* pool)
 {
-    ERR_DUMP_RET(this);
+    SoftAssertResult(reader, nullptr, ERROR_NULLPTR);
 
-    return _recRecalcNodes(this->root);
-}
+    typedef typename Node::ElementTraits Traits;
 
-Error _recRecalcNodes(TreeNode* node)
-{
-    SoftAssert(node, ERROR_NULLPTR);
+    // which part of current is expected next, finished nodes are left by their parent links
+    enum { READ_LEFT, READ_RIGHT, READ_CLOSE } expected = READ_LEFT;
 
-    if (node->id == BAD_ID)
-        return CREATE_ERROR(ERROR_TREE_LOOP);
+    Node* root    = nullptr;
+    Node* current = nullptr;
 
-    size_t oldId = node->id;
-    node->id = BAD_ID;
+    while (true)
+    {
+        TreeTokenResult wordRes = reader->NextToken();
+        if (wordRes.error)
+            return { nullptr, wordRes.error };
 
-    node->nodeCount = 1;
+        TreeToken word = wordRes.value;
+        if (!word.begin)
+            return { nullptr, CREATE_ERROR(ERROR_SYNTAX) };
 
-    if (!node->left && !node->right)
-        return Error();
-    
-    if (node->left)
-    {
-        RETURN_ERROR(_recRecalcNodes(node->left));
-        node->nodeCount += node->left->nodeCount;
-    }
-    if (node->right)
-    {
-        RETURN_ERROR(_recRecalcNodes(node->right));
-        node->nodeCount += node->right->nodeCount;
-    }
+        if (expected == READ_CLOSE)
+        {
+            if (!memchr(word.begin, ')', word.length))
+                return { nullptr, CREATE_ERROR(ERROR_SYNTAX) };
+
+            #ifdef TREE_SUBTREE_SIZES
+            if (current->left)
+                current->nodeCount += current->left->nodeCount;
+            if (current->right)
+                current->nodeCount += current->right->nodeCount;
+            #endif
+
+            if (current == root)
+                return { root, Error() };
+
+            Node* child = current;
+            current  = current->parent;
+            expected = current->left == child ? READ_RIGHT : READ_CLOSE;
+            continue;
+        }
 
-    node->id = BAD_ID;
+        if (memchr(word.begin, '(', word.length))
+        {
+            wordRes = reader->NextToken();
+            if (wordRes.error)
+                return { nullptr, wordRes.error };
 
-    return Error();
-}
-#endif
+            typename Node::Element value = Traits::POISON;
+            if (!wordRes.value.begin || !Traits::Parse(wordRes.value, &value))
+                return { nullptr, CREATE_ERROR(ERROR_SYNTAX) };
+
+            typename Node::Result nodeRes = Node::New(value, nullptr, nullptr, pool);
+            RETURN_RESULT(nodeRes);
+
+            Node* node = nodeRes.value;
+
+            if (!current)
+                root = node;
+            else if (expected == READ_LEFT)
+                current->left  = node;
+            else
+                current->right = node;
+
+            node->parent = current;
+            current      = node;
+            expected     = READ_LEFT;
+        }
+        else if (memmem(word.begin, word.length, "nil", 3))
+        {
+            if (!current)
+                return { nullptr, Error() };
 
-#define FONT_SIZE "10"
-#define FONT_NAME "\"Fira Code Bold\""
-#define BACK_GROUND_COLOR "\"#de97d4\""
-#define TREE_COLOR "\"#ff7be9\""
-#define NODE_COLOR "\"#fae1f6\""
-#define NODE_FRAME_COLOR "\"#000000\""
-#define ROOT_COLOR "\"#c95b90\""
-#define FREE_HEAD_COLOR "\"#b9e793\""
+            expected = expected == READ_LEFT ? READ_RIGHT : READ_CLOSE;
+        }
+        else
+            return { nullptr, CREATE_ERROR(ERROR_SYNTAX) };
+    }
+}
 
-Error Tree::Dump()
+template <typename T, typename Traits>
+Error BasicTree<T, Traits>::WriteBinary(const char* outPath) const
 {
-    static size_t DUMP_ITERATION = 0;
+    SoftAssert(outPath, ERROR_NULLPTR);
 
-    SoftAssert(this->root, ERROR_NO_ROOT);
+    TreeNodeCountResult countRes = this->CountNodes();
+    RETURN_ERROR(countRes.error);
 
-    if (HTML_FILE)
-        fprintf(HTML_FILE, 
-        "<h1>Iteration %zu</h1>\n"
-        "<style>\n"
-        ".content {\n"
-        "max-width: 500px;\n"
-        "margin: auto;\n"
-        "}\n"
-        "</style>,\n",
-        DUMP_ITERATION);
-
-    char outGraphPath[MAX_PATH_LENGTH] = "";
-    sprintf(outGraphPath, "%s/dot/Iteration%zu.dot", LOG_FOLDER, DUMP_ITERATION);
-
-    FILE* outGraphFile = fopen(outGraphPath, "w");
-    SoftAssert(outGraphFile, ERROR_BAD_FILE);
-
-    fprintf(outGraphFile, 
-    "digraph\n"
-    "{\n"
-    "rankdir = TB;\n"
-    "node[shape = record, color = " NODE_FRAME_COLOR ", fontname = " FONT_NAME ", fontsize = " FONT_SIZE "];\n"
-    "bgcolor = " BACK_GROUND_COLOR ";\n"
-    );
-
-    fprintf(outGraphFile, "TREE[rank = \"min\", style = \"filled\", fillcolor = " TREE_COLOR ", "
-                          "label = \"{Tree|Error: %s|"
-                          #ifndef NDEBUG
-                          "Size: %zu|"
-                          #endif
-                          "<root>Root}\"];",
-                          this->Verify().GetErrorName()
-                          #ifndef NDEBUG
-                          , *this->size
-                          #endif
-                          );
-
-    fprintf(outGraphFile, "\nNODE_%p[style = \"filled\", fillcolor = " NODE_COLOR ", ",
-                           this->root);
-    if (this->root->value == TREE_POISON)
-        fprintf(outGraphFile, "label = \"{Value:\\nPOISON|{<left>Left|<right>Right}}\"];\n");
-    else
-        fprintf(outGraphFile,
-        "label = \"{Value:\\n" TREE_ELEMENT_SPECIFIER "|"
-        "{<left>Left|<right>Right}}\"];\n", this->root->value);
+    uint64_t start     = TreeStatsStart();
+    size_t   shapeSize = TreeBinaryShapeSize(countRes.value);
+    uint8_t* shape     = (uint8_t*)calloc(shapeSize, 1);
+    if (!shape)
+        return CREATE_ERROR(ERROR_NO_MEMORY);
 
-    size_t MAX_DEPTH = MAX_TREE_SIZE;
-    #ifndef NDEBUG
-    MAX_DEPTH = min(*this->size, MAX_TREE_SIZE);
-    #endif
+    size_t index = 0;
+    TreePreOrder(this->root, [shape, &index](Node* node, size_t)
+    {
+        uint8_t bits = 0;
+        if (node->left)
+            bits |= TREE_BINARY_HAS_LEFT;
+        if (node->right)
+            bits |= TREE_BINARY_HAS_RIGHT;
 
-    if (this->root->left)
-        RETURN_ERROR(_recBuildCellTemplatesGraph(this->root->left,  outGraphFile, 0, MAX_DEPTH));
-    if (this->root->right)
-        RETURN_ERROR(_recBuildCellTemplatesGraph(this->root->right, outGraphFile, 0, MAX_DEPTH));
+        shape[index / 4] |= (uint8_t)(bits << (index % 4 * 2));
+        index++;
 
-    RETURN_ERROR(_recDrawGraph(this->root, outGraphFile, 0, MAX_DEPTH));
-    fprintf(outGraphFile, "\n");
-    fprintf(outGraphFile, "TREE:root->NODE_%p\n", this->root);
+        return Error();
+    });
 
-    fprintf(outGraphFile, "}\n");
-    fclose(outGraphFile);
+    T*    chunk   = (T*)calloc(TREE_BINARY_CHUNK_VALUES, sizeof(*chunk));
+    FILE* outFile = fopen(outPath, "wb");
 
-    char command[MAX_COMMAND_LENGTH] = "";
-    sprintf(command, "dot %s -T png -o %s/img/Iteration%zu.png", outGraphPath, LOG_FOLDER, DUMP_ITERATION);
-    system(command);
+    if (!chunk || !outFile)
+    {
+        free(shape);
+        free(chunk);
+        if (outFile)
+            fclose(outFile);
+        return !chunk ? CREATE_ERROR(ERROR_NO_MEMORY) : CREATE_ERROR(ERROR_BAD_FILE);
+    }
 
-    if (HTML_FILE)
-        fprintf(HTML_FILE, "<img src = \"%s/img/Iteration%zu.png\"/>\n", LOG_FOLDER, DUMP_ITERATION);
+    TreeBinaryHeader header = {};
+    memcpy(header.signature, TREE_BINARY_SIGNATURE, sizeof(header.signature));
+    header.version     = TREE_BINARY_VERSION;
+    header.elementSize = sizeof(T);
+    header.elementKind = Traits::KIND;
+    header.nodeCount   = countRes.value;
 
-    DUMP_ITERATION++;
+    bool written = fwrite(&header, sizeof(header), 1, outFile) == 1 &&
+                   fwrite(shape, 1, shapeSize, outFile) == shapeSize;
 
-    return Error();
-}
+    size_t chunkSize = 0;
+    if (written)
+        TreePreOrder(this->root, [chunk, &chunkSize, &written, outFile](Node* node, size_t)
+        {
+            chunk[chunkSize++] = node->value;
 
-static Error _recBuildCellTemplatesGraph(TreeNode* node, FILE* outGraphFile,
-                                             size_t curDepth, const size_t maxDepth)
-{
-    SoftAssert(node, ERROR_NULLPTR);
+            if (chunkSize == TREE_BINARY_CHUNK_VALUES)
+            {
+                written   = written && fwrite(chunk, sizeof(*chunk), chunkSize, outFile) == chunkSize;
+                chunkSize = 0;
+            }
 
-    size_t nodeId = node->id;
-    
-    if (curDepth > maxDepth)
-        return Error();
+            return Error();
+        });
 
-    fprintf(outGraphFile, "NODE_%p[style = \"filled\", fillcolor = " NODE_COLOR ", ", node);
-    fprintf(outGraphFile, "label = \"{Value:\\n");
-    if (node->value == TREE_POISON)
-        fprintf(outGraphFile, "POISON");
-    else
-        fprintf(outGraphFile, TREE_ELEMENT_SPECIFIER, node->value);
-    fprintf(outGraphFile, "|id:\\n");
+    written = written && fwrite(chunk, sizeof(*chunk), chunkSize, outFile) == chunkSize;
+    written = fclose(outFile) == 0 && written;
 
-    if (node->id == BAD_ID)
-        fprintf(outGraphFile, "BAD_ID");
-    else
-        fprintf(outGraphFile, "%zu", node->id);
+    free(shape);
+    free(chunk);
 
-    #ifndef NDEBUG
-    fprintf(outGraphFile, "|node count:\\n%zu", node->nodeCount);
-    #endif
-    fprintf(outGraphFile, "|{<left>left|<right>right}}\"];\n");
-    
-    if (node->left)
-        RETURN_ERROR(_recBuildCellTemplatesGraph(node->left,  outGraphFile, curDepth + 1, maxDepth));
-    if (node->right)
-        RETURN_ERROR(_recBuildCellTemplatesGraph(node->right, outGraphFile, curDepth + 1, maxDepth));
+    TreeStatsEnd(TREE_STATS_WRITE_BINARY, start);
+    TreeStatsAdd(TREE_STATS_WRITE_BINARY, countRes.value,
+                 sizeof(header) + shapeSize + countRes.value * sizeof(T));
 
-    return Error();
+    return written ? Error() : CREATE_ERROR(ERROR_BAD_FILE);
 }
 
-#undef FONT_SIZE
-#undef FONT_NAME
-#undef BACK_GROUND_COLOR
-#undef NODE_COLOR
-#undef NODE_FRAME_COLOR
-#undef ROOT_COLOR
-#undef FREE_HEAD_COLOR
-
-static Error _recDrawGraph(TreeNode* node, FILE* outGraphFile, size_t curDepth, const size_t maxDepth)
+template <typename T, typename Traits>
+Error BasicTree<T, Traits>::ReadBinary(const char* readPath)
 {
-    SoftAssert(node, ERROR_NULLPTR);
-    if (curDepth > maxDepth)
-        return Error();
+    SoftAssert(readPath, ERROR_NULLPTR);
+
+    int fd = open(readPath, O_RDONLY);
+    if (fd < 0)
+        return CREATE_ERROR(ERROR_BAD_FILE);
+
+    struct stat fileStat = {};
+    if (fstat(fd, &fileStat) != 0)
+    {
+        close(fd);
+        return CREATE_ERROR(ERROR_BAD_FILE);
+    }
+
+    uint64_t start = TreeStatsStart();
+
+    Pool*                 pool    = nullptr;
+    typename Node::Result rootRes = { nullptr, _newPool(&pool) };
 
-    if (node->left)
+    if (rootRes.error)
+        close(fd);
+    else if (S_ISREG(fileStat.st_mode))
     {
-        fprintf(outGraphFile, "NODE_%p:left->NODE_%p;\n", node, node->left);
-        RETURN_ERROR(_recDrawGraph(node->left, outGraphFile, curDepth + 1, maxDepth));
+        rootRes = _readBinaryMapped<Node>(fd, (size_t)fileStat.st_size, pool);
+        close(fd);
+    }
+    else
+    {
+        FILE* readFile = fdopen(fd, "rb");
+        if (!readFile)
+        {
+            close(fd);
+            rootRes.error = CREATE_ERROR(ERROR_BAD_FILE);
+        }
+        else
+        {
+            rootRes = _readBinaryStream<Node>(readFile, pool);
+            fclose(readFile);
+        }
     }
-    if (node->right)
+
+    // a file which was read whole is as long as its format says
+    size_t nodes = pool ? pool->nodesInUse : 0;
+    TreeStatsEnd(TREE_STATS_READ_BINARY, start);
+    if (!rootRes.error)
+        TreeStatsAdd(TREE_STATS_READ_BINARY, nodes,
+                     sizeof(TreeBinaryHeader) + TreeBinaryShapeSize(nodes) + nodes * sizeof(T));
+
+    if (rootRes.error)
     {
-        fprintf(outGraphFile, "NODE_%p:right->NODE_%p;\n", node, node->right);
-        RETURN_ERROR(_recDrawGraph(node->right, outGraphFile, curDepth + 1, maxDepth));
+        _deletePool(pool);
+        return rootRes.error;
     }
+
+    this->root = rootRes.value;
+    this->pool = pool;
+
     return Error();
 }
 
-Error Tree::Print(const char* outPath)
+template <typename Node>
+static Error _checkBinaryHeader(const TreeBinaryHeader* header)
 {
-    SoftAssert(outPath, ERROR_NULLPTR);
-    ERR_DUMP_RET(this);
-
-    FILE* outFile = fopen(outPath, "wb");
-    SoftAssert(outFile, ERROR_BAD_FILE);
-
-    RETURN_ERROR(_recPrint(this->root, outFile));
+    if (memcmp(header->signature, TREE_BINARY_SIGNATURE, sizeof(header->signature)) != 0 ||
+        header->version     != TREE_BINARY_VERSION ||
+        header->elementSize != sizeof(typename Node::Element) ||
+        header->elementKind != Node::ElementTraits::KIND)
+        return CREATE_ERROR(ERROR_SYNTAX);
 
-    fclose(outFile);
+    if (header->nodeCount == 0)
+        return CREATE_ERROR(ERROR_NO_ROOT);
 
     return Error();
 }
 
-static Error _recPrint(TreeNode* node, FILE* outFile)
+// marks a right child which is yet to be read
+template <typename Node>
+static Node RIGHT_PENDING = {};
+
+/** @struct BinaryTreeBuilder
+ * @brief Links nodes given one by one in pre-order with their shape bits
+ *
+ * @var BinaryTreeBuilder::current - node whose child comes next
+ * @var BinaryTreeBuilder::readLeft - whether the next node is the left child of current
+ * @var BinaryTreeBuilder::done - the root is complete
+ */
+template <typename Node>
+struct BinaryTreeBuilder
 {
-    if (!node)
+    typename Node::Pool* pool;
+    Node*                root;
+    Node*                current;
+    bool                 readLeft;
+    bool                 done;
+
+    Error Add(typename Node::Element value, uint8_t bits)
     {
-        fprintf(outFile, "nil%s", TREE_WORD_SEPARATOR);
-        return Error();
+        if (this->done)
+            return CREATE_ERROR(ERROR_SYNTAX);
+
+        typename Node::Result nodeRes = Node::New(value, nullptr, nullptr, this->pool);
+        RETURN_ERROR(nodeRes.error);
+
+        Node* node = nodeRes.value;
+
+        if (!this->current)
+            this->root = node;
+        else if (this->readLeft)
+            this->current->left  = node;
+        else
+            this->current->right = node;
+        node->parent = this->current;
+
+        if (bits & TREE_BINARY_HAS_RIGHT)
+            node->right = &RIGHT_PENDING<Node>;
+
+        if (bits)
+        {
+            this->current  = node;
+            this->readLeft = bits & TREE_BINARY_HAS_LEFT;
+            return Error();
+        }
+
+        // a leaf: climb while nodes are complete, stop at the first one waiting for its right child
+        Node* finished = node;
+        while (true)
+        {
+            #ifdef TREE_SUBTREE_SIZES
+            if (finished->left)
+                finished->nodeCount += finished->left->nodeCount;
+            if (finished->right)
+                finished->nodeCount += finished->right->nodeCount;
+            #endif
+
+            Node* parent = finished->parent;
+            if (!parent)
+            {
+                this->done = true;
+                return Error();
+            }
+
+            if (parent->left == finished && parent->right == &RIGHT_PENDING<Node>)
+            {
+                this->current  = parent;
+                this->readLeft = false;
+                return Error();
+            }
+
+            finished = parent;
+        }
     }
 
-    fprintf(outFile, "(%s" TREE_ELEMENT_SPECIFIER "%s", TREE_WORD_SEPARATOR, node->value, TREE_WORD_SEPARATOR);
-    RETURN_ERROR(_recPrint(node->left, outFile));
-    RETURN_ERROR(_recPrint(node->right, outFile));
-    fprintf(outFile, ")%s", TREE_WORD_SEPARATOR);
+    typename Node::Result Result()
+    {
+        if (!this->done)
+            return { nullptr, CREATE_ERROR(ERROR_SYNTAX) };
 
-    return Error();
-}
+        return { this->root, Error() };
+    }
+};
 
-Error Tree::Read(const char* readPath)
+template <typename Node>
+static typename Node::Result _readBinaryMapped(int fd, size_t fileSize, typename Node::Pool* pool)
 {
-    SoftAssert(readPath, ERROR_NULLPTR);
+    typedef typename Node::Element T;
 
-    FILE* readFile = fopen(readPath, "rb");
-    if (!readFile) return CREATE_ERROR(ERROR_BAD_FILE);
+    if (fileSize < sizeof(TreeBinaryHeader))
+        return { nullptr, CREATE_ERROR(ERROR_BAD_FILE) };
+
+    void* image = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (image == MAP_FAILED)
+        return { nullptr, CREATE_ERROR(ERROR_BAD_FILE) };
 
-    size_t fileSize = GetFileSize(readPath);
-    char*  buffer   = (char*)calloc(fileSize + 1, 1);
-    if (!buffer)
+    madvise(image, fileSize, MADV_SEQUENTIAL);
+
+    const TreeBinaryHeader* header = (const TreeBinaryHeader*)image;
+
+    Error error = _checkBinaryHeader<Node>(header);
+
+    size_t shapeSize = 0;
+    if (!error)
     {
-        fclose(readFile);
-        return CREATE_ERROR(ERROR_NO_MEMORY);
+        shapeSize = TreeBinaryShapeSize(header->nodeCount);
+        if ((fileSize - sizeof(*header) - shapeSize) / sizeof(T) < header->nodeCount ||
+            fileSize < sizeof(*header) + shapeSize)
+            error = CREATE_ERROR(ERROR_BAD_FILE);
     }
 
-    if (fread(buffer, 1, fileSize, readFile) != fileSize)
+    if (error)
     {
-        fclose(readFile);
-        free(buffer);
-        return CREATE_ERROR(ERROR_BAD_FILE);
+        munmap(image, fileSize);
+        return { nullptr, error };
     }
 
-    String string = {};
-    string.Create(buffer, fileSize);
-
-    SplitStringResult splitRes = string.Split(TREE_WORD_SEPARATOR);
-    RETURN_ERROR(splitRes.error);
+    // the shape is padded to 8 bytes, so values are aligned right in the image
+    const uint8_t* shape  = (const uint8_t*)(header + 1);
+    const T*       values = (const T*)(shape + shapeSize);
 
-    size_t wordNum = 0;
+    BinaryTreeBuilder<Node> builder = {};
+    builder.pool = pool;
 
-    TreeNodeResult rootRes = _recRead(&splitRes.value, &wordNum);
+    for (size_t index = 0; index < header->nodeCount && !error; index++)
+        error = builder.Add(values[index], TreeBinaryGetShape(shape, index));
 
-    RETURN_ERROR(rootRes.error);
+    munmap(image, fileSize);
 
-    splitRes.value.Destructor();
+    if (error)
+        return { nullptr, error };
 
-    return this->Init(rootRes.value);
+    return builder.Result();
 }
 
-static TreeNodeResult _recRead(SplitString* split, size_t* wordsNum)
+template <typename Node>
+static typename Node::Result _readBinaryStream(FILE* readFile, typename Node::Pool* pool)
 {
-    SoftAssertResult(split, nullptr, ERROR_NULLPTR);
+    typedef typename Node::Element T;
 
-    String* currentWord = &split->words[(*wordsNum)++];
+    TreeBinaryHeader header = {};
+    if (fread(&header, sizeof(header), 1, readFile) != 1)
+        return { nullptr, CREATE_ERROR(ERROR_BAD_FILE) };
 
-    char* openBracket = strchr(currentWord->buf, '(');
-    if (openBracket)
-        return _recReadOpenBracket(split, wordsNum);
+    Error error = _checkBinaryHeader<Node>(&header);
+    if (error)
+        return { nullptr, error };
 
-    const char* nil = strstr(currentWord->buf, "nil");
-    if (nil)
-        return { nullptr, Error() };
-    return { nullptr, CREATE_ERROR(ERROR_SYNTAX) };
-}
+    size_t   shapeSize = TreeBinaryShapeSize(header.nodeCount);
+    uint8_t* shape     = (uint8_t*)calloc(shapeSize, 1);
+    T*       chunk     = (T*)calloc(TREE_BINARY_CHUNK_VALUES, sizeof(*chunk));
 
-static TreeNodeResult _recReadOpenBracket(SplitString* split, size_t* wordNum)
-{
-    String openBracketString = {};
+    if (!shape || !chunk)
+        error = CREATE_ERROR(ERROR_NO_MEMORY);
+    else if (fread(shape, 1, shapeSize, readFile) != shapeSize)
+        error = CREATE_ERROR(ERROR_BAD_FILE);
 
-    String* word = &split->words[(*wordNum)++];
+    BinaryTreeBuilder<Node> builder = {};
+    builder.pool = pool;
 
-    TreeElement_t value = TREE_POISON;
-    int readChars = 0;
+    for (size_t index = 0; index < header.nodeCount && !error; )
+    {
+        size_t chunkSize = min(header.nodeCount - index, TREE_BINARY_CHUNK_VALUES);
 
-    if (sscanf(word->buf, TREE_ELEMENT_SPECIFIER "%n", &value, &readChars) != 1)
-        return { nullptr, CREATE_ERROR(ERROR_SYNTAX) };
-    
-    TreeNodeResult leftRes = _recRead(split, wordNum);
-    RETURN_RESULT(leftRes);
+        if (fread(chunk, sizeof(*chunk), chunkSize, readFile) != chunkSize)
+        {
+            error = CREATE_ERROR(ERROR_BAD_FILE);
+            break;
+        }
 
-    TreeNodeResult rightRes = _recRead(split, wordNum);
-    RETURN_RESULT(rightRes);
+        for (size_t chunkPos = 0; chunkPos < chunkSize && !error; chunkPos++, index++)
+            error = builder.Add(chunk[chunkPos], TreeBinaryGetShape(shape, index));
+    }
 
-    TreeNodeResult nodeRes = TreeNode::New(value, leftRes.value, rightRes.value);
-    RETURN_RESULT(nodeRes);
+    free(shape);
+    free(chunk);
 
-    word = &split->words[(*wordNum)++];
+    if (error)
+        return { nullptr, error };
 
-    const char* closeBracket = strchr(word->buf, ')');
-    if (!closeBracket)
-        return { nullptr, CREATE_ERROR(ERROR_SYNTAX) };
-    
-    return nodeRes;
+    return builder.Result();
 }
 
-Error Tree::StartLogging(const char* logFolder)
+template <typename T, typename Traits>
+Error BasicTree<T, Traits>::StartLogging(const char* logFolder)
 {
     SoftAssert(logFolder, ERROR_NULLPTR);
 
@@ -714,8 +2641,16 @@ Error Tree::StartLogging(const char* logFolder)
     return Error();
 }
 
-Error Tree::EndLogging()
+template <typename T, typename Traits>
+Error BasicTree<T, Traits>::EndLogging()
 {
+    RETURN_ERROR(TreeDumpJob::Drain());
+
+    #ifdef TREE_STATS
+    if (HTML_FILE)
+        RETURN_ERROR(LogStats());
+    #endif
+
     if (HTML_FILE)
     {
         fprintf(HTML_FILE, "</div>\n</body>\n");
@@ -725,3 +2660,57 @@ Error Tree::EndLogging()
 
     return Error();
 }
+
+template <typename T, typename Traits>
+TreeStats BasicTree<T, Traits>::Stats()
+{
+    TreeStats stats = {};
+
+    for (size_t operation = 0; operation < TREE_STATS_OPERATIONS_COUNT; operation++)
+    {
+        const TreeStatsCounters* counters = &TREE_STATS_COUNTERS[operation];
+
+        stats.operations[operation].calls  = counters->calls.load(std::memory_order_relaxed);
+        stats.operations[operation].cycles = counters->cycles.load(std::memory_order_relaxed);
+        stats.operations[operation].nodes  = counters->nodes.load(std::memory_order_relaxed);
+        stats.operations[operation].bytes  = counters->bytes.load(std::memory_order_relaxed);
+    }
+
+    return stats;
+}
+
+template <typename T, typename Traits>
+Error BasicTree<T, Traits>::ResetStats()
+{
+    for (size_t operation = 0; operation < TREE_STATS_OPERATIONS_COUNT; operation++)
+    {
+        TreeStatsCounters* counters = &TREE_STATS_COUNTERS[operation];
+
+        counters->calls.store(0, std::memory_order_relaxed);
+        counters->cycles.store(0, std::memory_order_relaxed);
+        counters->nodes.store(0, std::memory_order_relaxed);
+        counters->bytes.store(0, std::memory_order_relaxed);
+    }
+
+    return Error();
+}
+
+template <typename T, typename Traits>
+Error BasicTree<T, Traits>::LogStats()
+{
+    SoftAssert(HTML_FILE, ERROR_BAD_FILE);
+
+    TreeStats stats = Stats();
+
+    flockfile(HTML_FILE);
+    Error error = stats.WriteHtml(HTML_FILE);
+    funlockfile(HTML_FILE);
+
+    return error;
+}
+
+#define INSTANTIATE_TREE(T)             \
+    template struct BasicTreeNode<T>;   \
+    template struct BasicTree<T>;
+TREE_ELEMENT_TYPES(INSTANTIATE_TREE)
+#undef INSTANTIATE_TREE
@@ -0,0 +1,411 @@
+#include <stdlib.h>
+#include <string.h>
+#include "TreeCompact.hpp"
+#include "TreeWalk.hpp"
+
+template <typename Compact, typename Enter, typename Leave>
+static Error _walk(const Compact* tree, Enter enter, Leave leave);
+
+template <typename T>
+static Error _grow(T** array, size_t capacity);
+
+template <typename T, typename Traits>
+Error BasicCompactTree<T, Traits>::Init(size_t capacity)
+{
+    this->values   = nullptr;
+    this->left     = nullptr;
+    this->right    = nullptr;
+    this->parent   = nullptr;
+    this->root     = TREE_COMPACT_NONE;
+    this->size     = 0;
+    this->capacity = 0;
+
+    return this->Reserve(capacity);
+}
+
+template <typename T, typename Traits>
+Error BasicCompactTree<T, Traits>::Destructor()
+{
+    free(this->values);
+    free(this->left);
+    free(this->right);
+    free(this->parent);
+
+    this->values   = nullptr;
+    this->left     = nullptr;
+    this->right    = nullptr;
+    this->parent   = nullptr;
+    this->root     = TREE_COMPACT_NONE;
+    this->size     = 0;
+    this->capacity = 0;
+
+    return Error();
+}
+
+template <typename T, typename Traits>
+Error BasicCompactTree<T, Traits>::Reserve(size_t capacity)
+{
+    if (capacity <= this->capacity)
+        return Error();
+
+    // TREE_COMPACT_NONE itself is not an index
+    if (capacity > TREE_COMPACT_NONE)
+        return CREATE_ERROR(ERROR_BAD_SIZE);
+
+    RETURN_ERROR(_grow(&this->values, capacity));
+    RETURN_ERROR(_grow(&this->left,   capacity));
+    RETURN_ERROR(_grow(&this->right,  capacity));
+    RETURN_ERROR(_grow(&this->parent, capacity));
+
+    this->capacity = capacity;
+
+    return Error();
+}
+
+template <typename T>
+static Error _grow(T** array, size_t capacity)
+{
+    T* newArray = (T*)realloc(*array, capacity * sizeof(**array));
+    if (!newArray)
+        return CREATE_ERROR(ERROR_NO_MEMORY);
+
+    *array = newArray;
+
+    return Error();
+}
+
+template <typename T, typename Traits>
+TreeIndexResult BasicCompactTree<T, Traits>::Add(T value)
+{
+    if (this->size == this->capacity)
+    {
+        Error error = this->Reserve(this->capacity ? 2 * this->capacity : 64);
+        if (error)
+            return { TREE_COMPACT_NONE, error };
+    }
+
+    TreeIndex_t node = (TreeIndex_t)this->size++;
+
+    this->values[node] = value;
+    this->left[node]   = TREE_COMPACT_NONE;
+    this->right[node]  = TREE_COMPACT_NONE;
+    this->parent[node] = TREE_COMPACT_NONE;
+
+    if (this->root == TREE_COMPACT_NONE)
+        this->root = node;
+
+    return { node, Error() };
+}
+
+template <typename T, typename Traits>
+Error BasicCompactTree<T, Traits>::SetLeft(TreeIndex_t node, TreeIndex_t left)
+{
+    if (node >= this->size || left >= this->size)
+        return CREATE_ERROR(ERROR_BAD_SIZE);
+    if (this->parent[left] != TREE_COMPACT_NONE || left == this->root)
+        return CREATE_ERROR(ERROR_TREE_LOOP);
+
+    // nodes are never removed, a replaced child would be left hanging from nothing
+    if (this->left[node] != TREE_COMPACT_NONE)
+        return CREATE_ERROR(ERROR_BAD_TREE);
+
+    this->left[node]   = left;
+    this->parent[left] = node;
+
+    return Error();
+}
+
+template <typename T, typename Traits>
+Error BasicCompactTree<T, Traits>::SetRight(TreeIndex_t node, TreeIndex_t right)
+{
+    if (node >= this->size || right >= this->size)
+        return CREATE_ERROR(ERROR_BAD_SIZE);
+    if (this->parent[right] != TREE_COMPACT_NONE || right == this->root)
+        return CREATE_ERROR(ERROR_TREE_LOOP);
+
+    // nodes are never removed, a replaced child would be left hanging from nothing
+    if (this->right[node] != TREE_COMPACT_NONE)
+        return CREATE_ERROR(ERROR_BAD_TREE);
+
+    this->right[node]   = right;
+    this->parent[right] = node;
+
+    return Error();
+}
+
+template <typename T, typename Traits>
+Error BasicCompactTree<T, Traits>::Verify()
+{
+    if (this->root == TREE_COMPACT_NONE)
+        return CREATE_ERROR(ERROR_NO_ROOT);
+
+    if (this->root >= this->size || this->parent[this->root] != TREE_COMPACT_NONE)
+        return CREATE_ERROR(ERROR_TREE_LOOP);
+
+    // links are checked in one pass over the arrays, every index is compared with size once
+    TreeIndex_t size = (TreeIndex_t)this->size;
+
+    for (TreeIndex_t node = 0; node < size; node++)
+    {
+        TreeIndex_t left   = this->left[node];
+        TreeIndex_t right  = this->right[node];
+        TreeIndex_t parent = this->parent[node];
+
+        if (left != TREE_COMPACT_NONE && (left >= size || this->parent[left] != node || left == right))
+            return CREATE_ERROR(ERROR_TREE_LOOP);
+        if (right != TREE_COMPACT_NONE && (right >= size || this->parent[right] != node))
+            return CREATE_ERROR(ERROR_TREE_LOOP);
+        if (parent != TREE_COMPACT_NONE &&
+            (parent >= size || (this->left[parent] != node && this->right[parent] != node)))
+            return CREATE_ERROR(ERROR_TREE_LOOP);
+    }
+
+    // nodes are never removed, so each of them must hang from the root
+    TreeNodeCountResult countRes = this->CountNodes();
+    RETURN_ERROR(countRes.error);
+
+    if (countRes.value != this->size)
+        return CREATE_ERROR(ERROR_BAD_TREE);
+
+    return Error();
+}
+
+template <typename T, typename Traits>
+TreeNodeCountResult BasicCompactTree<T, Traits>::CountNodes()
+{
+    if (this->root == TREE_COMPACT_NONE)
+        return { SIZET_POISON, CREATE_ERROR(ERROR_NO_ROOT) };
+
+    size_t count = 0;
+
+    Error error = _walk(this, [&count](TreeIndex_t, size_t)
+    {
+        count++;
+        return Error();
+    },
+    [](TreeIndex_t, size_t)
+    {
+        return Error();
+    });
+
+    if (error)
+        return { SIZET_POISON, error };
+
+    return { count, Error() };
+}
+
+template <typename T, typename Traits>
+Error BasicCompactTree<T, Traits>::Copy(const BasicCompactTree* source)
+{
+    SoftAssert(source, ERROR_NULLPTR);
+
+    RETURN_ERROR(this->Reserve(source->size));
+
+    memcpy(this->values, source->values, source->size * sizeof(*this->values));
+    memcpy(this->left,   source->left,   source->size * sizeof(*this->left));
+    memcpy(this->right,  source->right,  source->size * sizeof(*this->right));
+    memcpy(this->parent, source->parent, source->size * sizeof(*this->parent));
+
+    this->root = source->root;
+    this->size = source->size;
+
+    return Error();
+}
+
+template <typename T, typename Traits>
+Error BasicCompactTree<T, Traits>::FromTree(PointerTree* tree)
+{
+    SoftAssert(tree, ERROR_NULLPTR);
+
+    typedef typename PointerTree::Node Node;
+
+    TreeNodeCountResult countRes = tree->CountNodes();
+    RETURN_ERROR(countRes.error);
+    RETURN_ERROR(this->Reserve(countRes.value));
+
+    this->root = TREE_COMPACT_NONE;
+    this->size = 0;
+
+    // current follows the walk through the parent links of the new nodes
+    struct : TreeVisitor
+    {
+        BasicCompactTree* compact;
+        TreeIndex_t       current;
+
+        Error Enter(Node* node, size_t depth)
+        {
+            TreeIndexResult indexRes = this->compact->Add(node->value);
+            RETURN_ERROR(indexRes.error);
+
+            TreeIndex_t index = indexRes.value;
+
+            if (depth > 0)
+            {
+                if (node->parent->left == node)
+                    this->compact->left[this->current]  = index;
+                else
+                    this->compact->right[this->current] = index;
+
+                this->compact->parent[index] = this->current;
+            }
+            this->current = index;
+
+            return Error();
+        }
+
+        Error Leave(Node*, size_t)
+        {
+            this->current = this->compact->parent[this->current];
+            return Error();
+        }
+    } visitor;
+    visitor.compact = this;
+    visitor.current = TREE_COMPACT_NONE;
+
+    return TreeWalk(tree->root, visitor);
+}
+
+template <typename T, typename Traits>
+Error BasicCompactTree<T, Traits>::ToTree(PointerTree* tree)
+{
+    SoftAssert(tree, ERROR_NULLPTR);
+
+    typedef typename PointerTree::Node Node;
+    typedef typename PointerTree::Pool Pool;
+
+    if (this->root == TREE_COMPACT_NONE)
+        return CREATE_ERROR(ERROR_NO_ROOT);
+
+    Pool* pool = (Pool*)calloc(1, sizeof(*pool));
+    if (!pool)
+        return CREATE_ERROR(ERROR_NO_MEMORY);
+    pool->Init();
+
+    Node* current = nullptr;
+    Node* root    = nullptr;
+
+    Error error = _walk(this, [this, pool, &current, &root](TreeIndex_t index, size_t depth)
+    {
+        typename Node::Result nodeRes = Node::New(this->values[index], nullptr, nullptr, pool);
+        RETURN_ERROR(nodeRes.error);
+
+        Node* node = nodeRes.value;
+
+        if (depth == 0)
+            root = node;
+        else if (this->left[this->parent[index]] == index)
+            current->left  = node;
+        else
+            current->right = node;
+
+        node->parent = current;
+        current      = node;
+
+        return Error();
+    },
+    [&current](TreeIndex_t, size_t)
+    {
+        #ifdef TREE_SUBTREE_SIZES
+        if (current->left)
+            current->nodeCount += current->left->nodeCount;
+        if (current->right)
+            current->nodeCount += current->right->nodeCount;
+        #endif
+
+        current = current->parent;
+
+        return Error();
+    });
+
+    if (error)
+    {
+        pool->Destructor();
+        free(pool);
+        return error;
+    }
+
+    tree->root = root;
+    tree->pool = pool;
+
+    return Error();
+}
+
+/**
+ * @brief Same walk as @ref TreeWalk over indices, enter and leave get (index, depth)
+ *
+ * An index past the arrays is @ref ERROR_BAD_TREE, the arrays may come from a broken file.
+ */
+template <typename Compact, typename Enter, typename Leave>
+static Error _walk(const Compact* tree, Enter enter, Leave leave)
+{
+    enum { WALK_ENTERED, WALK_LEFT_DONE, WALK_RIGHT_DONE } state = WALK_ENTERED;
+
+    const TreeIndex_t* lefts   = tree->left;
+    const TreeIndex_t* rights  = tree->right;
+    const TreeIndex_t* parents = tree->parent;
+
+    TreeIndex_t start = tree->root;
+    TreeIndex_t node  = start;
+    size_t      depth = 0;
+
+    if (start >= tree->size)
+        return CREATE_ERROR(ERROR_BAD_TREE);
+
+    RETURN_ERROR(enter(node, depth));
+
+    while (true)
+    {
+        if (state == WALK_ENTERED)
+        {
+            TreeIndex_t left = lefts[node];
+            if (left != TREE_COMPACT_NONE)
+            {
+                if (left >= tree->size)
+                    return CREATE_ERROR(ERROR_BAD_TREE);
+                if (parents[left] != node || left == rights[node] || left == start)
+                    return CREATE_ERROR(ERROR_TREE_LOOP);
+
+                node = left;
+                depth++;
+                RETURN_ERROR(enter(node, depth));
+                continue;
+            }
+            state = WALK_LEFT_DONE;
+        }
+
+        if (state == WALK_LEFT_DONE)
+        {
+            TreeIndex_t right = rights[node];
+            if (right != TREE_COMPACT_NONE)
+            {
+                if (right >= tree->size)
+                    return CREATE_ERROR(ERROR_BAD_TREE);
+                if (parents[right] != node || right == start)
+                    return CREATE_ERROR(ERROR_TREE_LOOP);
+
+                node  = right;
+                state = WALK_ENTERED;
+                depth++;
+                RETURN_ERROR(enter(node, depth));
+                continue;
+            }
+            state = WALK_RIGHT_DONE;
+        }
+
+        if (node == start)
+            return leave(node, depth);
+
+        TreeIndex_t parent       = parents[node];
+        bool        cameFromLeft = lefts[parent] == node;
+
+        RETURN_ERROR(leave(node, depth));
+
+        node  = parent;
+        state = cameFromLeft ? WALK_LEFT_DONE : WALK_RIGHT_DONE;
+        depth--;
+    }
+}
+
+#define INSTANTIATE_COMPACT(T) template struct BasicCompactTree<T>;
+TREE_ELEMENT_TYPES(INSTANTIATE_COMPACT)
+#undef INSTANTIATE_COMPACT
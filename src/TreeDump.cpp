@@ -0,0 +1,509 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "TreeDump.hpp"
+#include "TreeWalk.hpp"
+
+extern char** environ;
+
+static const size_t MAX_PATH_LENGTH = 128;
+
+static pthread_mutex_t DUMP_MUTEX          = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  DUMP_CHANGED        = PTHREAD_COND_INITIALIZER;
+static pthread_t       DUMP_WORKER         = {};
+static bool            DUMP_WORKER_RUNNING = false;
+static bool            DUMP_STOP           = false;
+static bool            DUMP_DRAIN_AT_EXIT  = false;
+
+static TreeDumpJob*    DUMP_QUEUE[TREE_DUMP_QUEUE_SIZE] = {};
+static size_t          DUMP_QUEUE_HEAD  = 0;
+static size_t          DUMP_QUEUE_COUNT = 0;
+
+// only the worker touches running renders
+static pid_t           RENDERS[TREE_DUMP_MAX_RENDERS] = {};
+static size_t          RENDERS_COUNT = 0;
+
+static void* _dumpWorker(void*);
+
+static void _renderJob(TreeDumpJob* job);
+
+static void _reapRenders(bool wait);
+
+static void _drainAtExit();
+
+template <typename Traits, typename T>
+static void _formatValue(char* text, T value);
+
+static Error _write(TreeTextWriter* writer, const char* text);
+
+static Error _writeNumber(TreeTextWriter* writer, size_t number);
+
+static Error _writeName(TreeTextWriter* writer, bool compact, size_t index);
+
+template <typename T, typename Traits>
+Error TreeDumpJob::Init(BasicTreeNode<T, Traits>* root, const TreeDumpOptions* options)
+{
+    SoftAssert(root,    ERROR_NULLPTR);
+    SoftAssert(options, ERROR_NULLPTR);
+
+    typedef BasicTreeNode<T, Traits> Node;
+
+    this->options       = *options;
+    this->nodes         = nullptr;
+    this->nodesCount    = 0;
+    this->nodesCapacity = 0;
+
+    // the snapshot is the queue of a breadth first walk, queue[i] is the node nodes[i] was copied from
+    Node** queue = nullptr;
+    size_t shown = 0;
+
+    auto add = [this, options, &queue, &shown](Node* node, size_t depth)
+    {
+        if (this->nodesCount == this->nodesCapacity)
+        {
+            size_t        newCapacity = this->nodesCapacity ? 2 * this->nodesCapacity : 64;
+            TreeDumpNode* newNodes    = (TreeDumpNode*)realloc(this->nodes, newCapacity * sizeof(*newNodes));
+            if (!newNodes)
+                return CREATE_ERROR(ERROR_NO_MEMORY);
+            this->nodes = newNodes;
+
+            Node** newQueue = (Node**)realloc(queue, newCapacity * sizeof(*newQueue));
+            if (!newQueue)
+                return CREATE_ERROR(ERROR_NO_MEMORY);
+            queue = newQueue;
+
+            this->nodesCapacity = newCapacity;
+        }
+
+        queue[this->nodesCount] = node;
+        TreeDumpNode* copy = &this->nodes[this->nodesCount++];
+
+        copy->left        = 0;
+        copy->right       = 0;
+        copy->id          = node->id;
+        copy->depth       = depth;
+        copy->collapsed   = 0;
+        copy->maxValue[0] = '\0';
+        #ifdef TREE_SUBTREE_SIZES
+        copy->nodeCount   = node->nodeCount;
+        #else
+        copy->nodeCount   = 0;
+        #endif
+
+        // the root is always shown
+        if (depth == 0 || (depth <= options->maxDepth && shown < options->maxNodes))
+        {
+            shown++;
+            _formatValue<Traits>(copy->value, node->value);
+            return Error();
+        }
+
+        T      minValue = node->value;
+        T      maxValue = node->value;
+        size_t count    = 0;
+
+        RETURN_ERROR(TreePreOrder(node, [&minValue, &maxValue, &count](Node* inner, size_t)
+        {
+            count++;
+            if (inner->value < minValue)
+                minValue = inner->value;
+            if (maxValue < inner->value)
+                maxValue = inner->value;
+
+            return Error();
+        }));
+
+        copy->collapsed = count;
+        _formatValue<Traits>(copy->value,    minValue);
+        _formatValue<Traits>(copy->maxValue, maxValue);
+
+        return Error();
+    };
+
+    Error error = add(root, 0);
+
+    for (size_t index = 0; index < this->nodesCount && !error; index++)
+    {
+        if (this->nodes[index].collapsed)
+            continue;
+
+        Node*  node  = queue[index];
+        size_t depth = this->nodes[index].depth;
+
+        if (node->left)
+        {
+            this->nodes[index].left = this->nodesCount;
+            error = add(node->left, depth + 1);
+        }
+        if (node->right && !error)
+        {
+            this->nodes[index].right = this->nodesCount;
+            error = add(node->right, depth + 1);
+        }
+    }
+
+    free(queue);
+
+    return error;
+}
+
+Error TreeDumpJob::Destructor()
+{
+    free(this->nodes);
+
+    this->nodes         = nullptr;
+    this->nodesCount    = 0;
+    this->nodesCapacity = 0;
+
+    return Error();
+}
+
+#define FONT_SIZE "10"
+#define FONT_NAME "\"Fira Code Bold\""
+#define BACK_GROUND_COLOR "\"#de97d4\""
+#define TREE_COLOR "\"#ff7be9\""
+#define NODE_COLOR "\"#fae1f6\""
+#define NODE_FRAME_COLOR "\"#000000\""
+#define ROOT_COLOR "\"#c95b90\""
+#define FREE_HEAD_COLOR "\"#b9e793\""
+#define SUMMARY_COLOR "\"#c9c3f5\""
+
+Error TreeDumpJob::WriteDot(TreeTextWriter* writer) const
+{
+    SoftAssert(writer, ERROR_NULLPTR);
+    SoftAssert(this->nodesCount, ERROR_NO_ROOT);
+
+    bool compact = this->options.compact;
+
+    if (compact)
+        RETURN_ERROR(_write(writer,
+        "digraph\n"
+        "{\n"
+        "node[shape = box, fontname = " FONT_NAME ", fontsize = " FONT_SIZE "];\n"));
+    else
+    {
+        RETURN_ERROR(_write(writer,
+        "digraph\n"
+        "{\n"
+        "rankdir = TB;\n"
+        "node[shape = record, color = " NODE_FRAME_COLOR ", fontname = " FONT_NAME ", fontsize = " FONT_SIZE "];\n"
+        "bgcolor = " BACK_GROUND_COLOR ";\n"
+        "TREE[rank = \"min\", style = \"filled\", fillcolor = " TREE_COLOR ", label = \"{Tree|Error: "));
+        RETURN_ERROR(_write(writer, this->errorName));
+        #ifdef TREE_SUBTREE_SIZES
+        RETURN_ERROR(_write(writer, "|Size: "));
+        RETURN_ERROR(_writeNumber(writer, this->treeSize));
+        #endif
+        RETURN_ERROR(_write(writer, "|<root>Root}\"];\n"));
+    }
+
+    for (size_t i = 0; i < this->nodesCount; i++)
+    {
+        const TreeDumpNode* node = &this->nodes[i];
+
+        RETURN_ERROR(_writeName(writer, compact, i));
+
+        if (node->collapsed)
+        {
+            RETURN_ERROR(_write(writer, compact ? "[shape = folder, label = \"" :
+                                                  "[style = \"filled\", fillcolor = " SUMMARY_COLOR ", label = \"{"));
+            RETURN_ERROR(_writeNumber(writer, node->collapsed));
+            RETURN_ERROR(_write(writer, compact ? " nodes\\n" : " nodes|min:\\n"));
+            RETURN_ERROR(_write(writer, node->value));
+            RETURN_ERROR(_write(writer, compact ? " .. " : "|max:\\n"));
+            RETURN_ERROR(_write(writer, node->maxValue));
+            RETURN_ERROR(_write(writer, compact ? "\"];\n" : "}\"];\n"));
+            continue;
+        }
+
+        if (compact)
+        {
+            RETURN_ERROR(_write(writer, "[label = \""));
+            RETURN_ERROR(_write(writer, node->value));
+            RETURN_ERROR(_write(writer, "\"];\n"));
+            continue;
+        }
+
+        RETURN_ERROR(_write(writer, "[style = \"filled\", fillcolor = " NODE_COLOR ", label = \"{Value:\\n"));
+        RETURN_ERROR(_write(writer, node->value));
+
+        // the root is drawn under the tree's record, without its id and size
+        if (i != 0)
+        {
+            RETURN_ERROR(_write(writer, "|id:\\n"));
+            if (node->id == BAD_ID)
+                RETURN_ERROR(_write(writer, "BAD_ID"));
+            else
+                RETURN_ERROR(_writeNumber(writer, node->id));
+
+            #ifdef TREE_SUBTREE_SIZES
+            RETURN_ERROR(_write(writer, "|node count:\\n"));
+            if (node->nodeCount == TREE_SIZE_STALE)
+                RETURN_ERROR(_write(writer, "stale"));
+            else
+                RETURN_ERROR(_writeNumber(writer, node->nodeCount));
+            #endif
+        }
+
+        RETURN_ERROR(_write(writer, i == 0 ? "|{<left>Left|<right>Right}}\"];\n" : "|{<left>left|<right>right}}\"];\n"));
+    }
+
+    for (size_t i = 0; i < this->nodesCount; i++)
+    {
+        const TreeDumpNode* node = &this->nodes[i];
+
+        if (node->left)
+        {
+            RETURN_ERROR(_writeName(writer, compact, i));
+            RETURN_ERROR(_write(writer, compact ? "->" : ":left->"));
+            RETURN_ERROR(_writeName(writer, compact, node->left));
+            RETURN_ERROR(_write(writer, ";\n"));
+        }
+        if (node->right)
+        {
+            RETURN_ERROR(_writeName(writer, compact, i));
+            RETURN_ERROR(_write(writer, compact ? "->" : ":right->"));
+            RETURN_ERROR(_writeName(writer, compact, node->right));
+            RETURN_ERROR(_write(writer, ";\n"));
+        }
+    }
+
+    if (!compact)
+        RETURN_ERROR(_write(writer, "TREE:root->NODE_0\n"));
+
+    return _write(writer, "}\n");
+}
+
+#undef FONT_SIZE
+#undef FONT_NAME
+#undef BACK_GROUND_COLOR
+#undef TREE_COLOR
+#undef NODE_COLOR
+#undef NODE_FRAME_COLOR
+#undef ROOT_COLOR
+#undef FREE_HEAD_COLOR
+#undef SUMMARY_COLOR
+
+Error TreeDumpJob::Submit()
+{
+    pthread_mutex_lock(&DUMP_MUTEX);
+
+    if (!DUMP_WORKER_RUNNING)
+    {
+        DUMP_STOP = false;
+        if (pthread_create(&DUMP_WORKER, nullptr, _dumpWorker, nullptr) != 0)
+        {
+            pthread_mutex_unlock(&DUMP_MUTEX);
+            return CREATE_ERROR(ERROR_NO_MEMORY);
+        }
+        DUMP_WORKER_RUNNING = true;
+
+        if (!DUMP_DRAIN_AT_EXIT)
+            DUMP_DRAIN_AT_EXIT = atexit(_drainAtExit) == 0;
+    }
+
+    if (DUMP_QUEUE_COUNT == TREE_DUMP_QUEUE_SIZE)
+    {
+        pthread_mutex_unlock(&DUMP_MUTEX);
+        return CREATE_ERROR(ERROR_BAD_SIZE);
+    }
+
+    DUMP_QUEUE[(DUMP_QUEUE_HEAD + DUMP_QUEUE_COUNT) % TREE_DUMP_QUEUE_SIZE] = this;
+    DUMP_QUEUE_COUNT++;
+
+    pthread_cond_signal(&DUMP_CHANGED);
+    pthread_mutex_unlock(&DUMP_MUTEX);
+
+    return Error();
+}
+
+Error TreeDumpJob::Drain()
+{
+    pthread_mutex_lock(&DUMP_MUTEX);
+
+    if (!DUMP_WORKER_RUNNING)
+    {
+        pthread_mutex_unlock(&DUMP_MUTEX);
+        return Error();
+    }
+
+    DUMP_STOP = true;
+    pthread_cond_signal(&DUMP_CHANGED);
+    pthread_mutex_unlock(&DUMP_MUTEX);
+
+    pthread_join(DUMP_WORKER, nullptr);
+
+    pthread_mutex_lock(&DUMP_MUTEX);
+    DUMP_WORKER_RUNNING = false;
+    DUMP_STOP           = false;
+    pthread_mutex_unlock(&DUMP_MUTEX);
+
+    return Error();
+}
+
+static void* _dumpWorker(void*)
+{
+    while (true)
+    {
+        pthread_mutex_lock(&DUMP_MUTEX);
+
+        while (!DUMP_QUEUE_COUNT && !DUMP_STOP)
+            pthread_cond_wait(&DUMP_CHANGED, &DUMP_MUTEX);
+
+        if (!DUMP_QUEUE_COUNT)
+        {
+            pthread_mutex_unlock(&DUMP_MUTEX);
+            break;
+        }
+
+        TreeDumpJob* job = DUMP_QUEUE[DUMP_QUEUE_HEAD];
+        DUMP_QUEUE_HEAD  = (DUMP_QUEUE_HEAD + 1) % TREE_DUMP_QUEUE_SIZE;
+        DUMP_QUEUE_COUNT--;
+
+        pthread_mutex_unlock(&DUMP_MUTEX);
+
+        _renderJob(job);
+
+        job->Destructor();
+        free(job);
+    }
+
+    _reapRenders(true);
+
+    return nullptr;
+}
+
+static void _renderJob(TreeDumpJob* job)
+{
+    uint64_t start = TreeStatsStart();
+
+    char outGraphPath[MAX_PATH_LENGTH] = "";
+    snprintf(outGraphPath, MAX_PATH_LENGTH, "%s/dot/Iteration%zu.dot", job->logFolder, job->iteration);
+
+    char outImagePath[MAX_PATH_LENGTH] = "";
+    snprintf(outImagePath, MAX_PATH_LENGTH, "%s/img/Iteration%zu.png", job->logFolder, job->iteration);
+
+    int fd = open(outGraphPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        TreeStatsEnd(TREE_STATS_RENDER, start);
+        return;
+    }
+
+    TreeTextWriter writer = {};
+    Error error = writer.Init(fd);
+
+    if (!error)
+        error = job->WriteDot(&writer);
+    if (!error)
+        error = writer.Flush();
+
+    writer.Destructor();
+
+    off_t bytes = lseek(fd, 0, SEEK_CUR);
+    close(fd);
+
+    TreeStatsAdd(TREE_STATS_RENDER, job->nodesCount, bytes > 0 ? (uint64_t)bytes : 0);
+
+    if (error)
+    {
+        TreeStatsEnd(TREE_STATS_RENDER, start);
+        return;
+    }
+
+    _reapRenders(false);
+
+    // at most TREE_DUMP_MAX_RENDERS run at once, wait for the oldest
+    if (RENDERS_COUNT == TREE_DUMP_MAX_RENDERS)
+    {
+        waitpid(RENDERS[0], nullptr, 0);
+        RENDERS_COUNT--;
+        for (size_t i = 0; i < RENDERS_COUNT; i++)
+            RENDERS[i] = RENDERS[i + 1];
+    }
+
+    char  dot[]    = "dot";
+    char  format[] = "-Tpng";
+    char  output[] = "-o";
+    char* argv[]   = { dot, outGraphPath, format, output, outImagePath, nullptr };
+
+    pid_t pid = 0;
+    if (posix_spawnp(&pid, dot, nullptr, nullptr, argv, environ) == 0)
+        RENDERS[RENDERS_COUNT++] = pid;
+
+    // Graphviz itself runs on, only starting it and waiting for a free slot is counted
+    TreeStatsEnd(TREE_STATS_RENDER, start);
+}
+
+static void _reapRenders(bool wait)
+{
+    for (size_t i = 0; i < RENDERS_COUNT; )
+    {
+        if (waitpid(RENDERS[i], nullptr, wait ? 0 : WNOHANG) == 0)
+        {
+            i++;
+            continue;
+        }
+
+        RENDERS[i] = RENDERS[--RENDERS_COUNT];
+    }
+}
+
+static void _drainAtExit()
+{
+    TreeDumpJob::Drain();
+}
+
+/**
+ * @brief Writes value as text of at most @ref TREE_DUMP_VALUE_LENGTH bytes with the terminator
+ */
+template <typename Traits, typename T>
+static void _formatValue(char* text, T value)
+{
+    char* end = nullptr;
+    if (value != Traits::POISON)
+        end = Traits::Format(text, text + TREE_DUMP_VALUE_LENGTH - 1, value);
+
+    if (end)
+        *end = '\0';
+    else
+        strcpy(text, "POISON");
+}
+
+static Error _write(TreeTextWriter* writer, const char* text)
+{
+    return writer->Write(text, strlen(text));
+}
+
+static Error _writeNumber(TreeTextWriter* writer, size_t number)
+{
+    char  digits[3 * sizeof(number)] = "";
+    char* digit = digits + sizeof(digits);
+
+    do
+    {
+        *--digit = (char)('0' + number % 10);
+        number /= 10;
+    } while (number);
+
+    return writer->Write(digit, (size_t)(digits + sizeof(digits) - digit));
+}
+
+/**
+ * @brief Names nodes by their place in the snapshot, shorter than addresses
+ */
+static Error _writeName(TreeTextWriter* writer, bool compact, size_t index)
+{
+    RETURN_ERROR(_write(writer, compact ? "n" : "NODE_"));
+
+    return _writeNumber(writer, index);
+}
+
+#define INSTANTIATE_DUMP_INIT(T) template Error TreeDumpJob::Init(BasicTreeNode<T>* root,  \
+                                                                  const TreeDumpOptions* options);
+TREE_ELEMENT_TYPES(INSTANTIATE_DUMP_INIT)
+#undef INSTANTIATE_DUMP_INIT
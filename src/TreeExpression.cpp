@@ -0,0 +1,540 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#include "TreeExpression.hpp"
+#include "TreeWalk.hpp"
+#include "MinMax.hpp"
+
+/** @struct ExpressionNode
+ * @brief Node of the tree being compiled, children come before their parents
+ *
+ * @var ExpressionNode::left - index of the left child plus one, 0 if there is none
+ * @var ExpressionNode::right - the same for the right child
+ * @var ExpressionNode::need - stack slots the subtree takes, 0 for a leaf folded into its parent
+ */
+struct ExpressionNode
+{
+    double value;
+    size_t left;
+    size_t right;
+    size_t need;
+};
+
+/** @struct ExpressionTask
+ * @brief Node whose code is still to emit: its operands first, then its own instruction
+ */
+struct ExpressionTask
+{
+    size_t index;
+    bool   apply;
+};
+
+// a column leaf is a quiet NaN with these high bits and the column in the low ones
+static const uint64_t EXPRESSION_COLUMN_TAG  = 0x7FFC000000000000ull;
+static const uint64_t EXPRESSION_COLUMN_MASK = 0xFFFFFFFF00000000ull;
+
+static Error _flatten(const TreeExpression::PointerTree* tree, size_t columns, ExpressionNode** nodes,
+                      size_t* count);
+
+static Error _emit(const ExpressionNode* nodes, size_t count, TreeExpressionInstruction* code, size_t* size,
+                   size_t* stackSize);
+
+static TreeExpressionInstruction _leaf(TreeExpressionOp op, double value);
+
+static void _apply(TreeExpressionOp op, const double* left, const double* right, double constant,
+                   double* out, size_t count);
+
+#if defined(__AVX512F__)
+typedef __m512d ExpressionLanes;
+static const size_t EXPRESSION_LANES = 8;
+#elif defined(__AVX2__)
+typedef __m256d ExpressionLanes;
+static const size_t EXPRESSION_LANES = 4;
+#endif
+
+Error TreeExpression::Init()
+{
+    this->code      = nullptr;
+    this->size      = 0;
+    this->columns   = 0;
+    this->stackSize = 0;
+
+    return Error();
+}
+
+Error TreeExpression::Destructor()
+{
+    free(this->code);
+
+    return this->Init();
+}
+
+Error TreeExpression::Compile(const PointerTree* tree, size_t columns)
+{
+    SoftAssert(tree, ERROR_NULLPTR);
+    SoftAssert(tree->root, ERROR_NO_ROOT);
+
+    ExpressionNode* nodes = nullptr;
+    size_t          count = 0;
+    RETURN_ERROR(_flatten(tree, columns, &nodes, &count));
+
+    // every node makes at most one instruction
+    TreeExpressionInstruction* code = (TreeExpressionInstruction*)calloc(count, sizeof(*code));
+    if (!code)
+    {
+        free(nodes);
+        return CREATE_ERROR(ERROR_NO_MEMORY);
+    }
+
+    size_t size      = 0;
+    size_t stackSize = 0;
+    Error  error     = _emit(nodes, count, code, &size, &stackSize);
+    free(nodes);
+
+    if (error)
+    {
+        free(code);
+        return error;
+    }
+
+    free(this->code);
+    this->code      = code;
+    this->size      = size;
+    this->columns   = columns;
+    this->stackSize = stackSize;
+
+    return Error();
+}
+
+Error TreeExpression::Evaluate(const double* const* columns, size_t rows, double* results) const
+{
+    SoftAssert(this->size, ERROR_NO_ROOT);
+    SoftAssert(columns || !this->columns, ERROR_NULLPTR);
+    SoftAssert(results || !rows, ERROR_NULLPTR);
+
+    static const size_t BLOCK = TREE_EXPRESSION_BLOCK_SIZE;
+
+    // slot k of the stack is blocks[k * BLOCK..], tops[k] is its value: the slot or a column read in place
+    double*        blocks = (double*)aligned_alloc(TREE_CACHE_LINE_SIZE, this->stackSize * BLOCK * sizeof(*blocks));
+    const double** tops   = (const double**)calloc(this->stackSize, sizeof(*tops));
+    if (!blocks || !tops)
+    {
+        free(blocks);
+        free(tops);
+        return CREATE_ERROR(ERROR_NO_MEMORY);
+    }
+
+    for (size_t row = 0; row < rows; row += BLOCK)
+    {
+        size_t count = min(BLOCK, rows - row);
+        size_t depth = 0;
+
+        for (size_t index = 0; index < this->size; index++)
+        {
+            const TreeExpressionInstruction* instruction = &this->code[index];
+
+            const double* operand = nullptr;
+            if (instruction->source == TREE_EXPRESSION_COLUMN)
+                operand = columns[instruction->column] + row;
+            else if (instruction->source == TREE_EXPRESSION_STACK)
+                operand = tops[--depth];
+
+            if (instruction->op == TREE_EXPRESSION_PUSH)
+            {
+                double* slot = blocks + depth * BLOCK;
+
+                if (!operand)
+                {
+                    for (size_t i = 0; i < count; i++)
+                        slot[i] = instruction->constant;
+                    operand = slot;
+                }
+
+                tops[depth++] = operand;
+                continue;
+            }
+
+            double*       out = blocks + (depth - 1) * BLOCK;
+            const double* top = tops[depth - 1];
+
+            if (instruction->reversed)
+                _apply(instruction->op, operand, top, instruction->constant, out, count);
+            else
+                _apply(instruction->op, top, operand, instruction->constant, out, count);
+
+            tops[depth - 1] = out;
+        }
+
+        memcpy(results + row, tops[0], count * sizeof(*results));
+    }
+
+    free(blocks);
+    free(tops);
+
+    return Error();
+}
+
+double TreeExpressionColumn(size_t column)
+{
+    // a plain NaN is a constant, so a column that does not fit is not read as another one
+    if (column > UINT32_MAX)
+        return NAN;
+
+    uint64_t bits  = EXPRESSION_COLUMN_TAG | column;
+    double   value = 0;
+    memcpy(&value, &bits, sizeof(value));
+
+    return value;
+}
+
+bool TreeExpressionIsColumn(double value, size_t* column)
+{
+    uint64_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+
+    if ((bits & EXPRESSION_COLUMN_MASK) != EXPRESSION_COLUMN_TAG)
+        return false;
+
+    if (column)
+        *column = (size_t)(uint32_t)bits;
+
+    return true;
+}
+
+/**
+ * @brief Copies the tree into an array in post-order, working out how many
+ * stack slots each subtree needs and checking the operators and columns
+ */
+static Error _flatten(const TreeExpression::PointerTree* tree, size_t columns, ExpressionNode** nodes,
+                      size_t* count)
+{
+    typedef TreeExpression::PointerTree::Node Node;
+
+    size_t total = 0;
+    RETURN_ERROR(TreePreOrder(tree->root, [&total](Node*, size_t)
+    {
+        total++;
+        return Error();
+    }));
+
+    ExpressionNode* flat    = (ExpressionNode*)calloc(total, sizeof(*flat));
+    size_t*         pending = (size_t*)calloc(total, sizeof(*pending));
+    if (!flat || !pending)
+    {
+        free(flat);
+        free(pending);
+        return CREATE_ERROR(ERROR_NO_MEMORY);
+    }
+
+    // children left their indices on top of pending, the right one last
+    size_t size        = 0;
+    size_t pendingSize = 0;
+
+    Error error = TreePostOrder(tree->root, [flat, pending, &size, &pendingSize, columns](Node* node, size_t)
+    {
+        ExpressionNode* copy = &flat[size];
+
+        copy->value = node->value;
+        copy->right = node->right ? pending[--pendingSize] + 1 : 0;
+        copy->left  = node->left  ? pending[--pendingSize] + 1 : 0;
+
+        if (!copy->left && !copy->right)
+        {
+            size_t column = 0;
+            if (TreeExpressionIsColumn(node->value, &column) && column >= columns)
+                return CREATE_ERROR(ERROR_SYNTAX);
+
+            copy->need = 0;
+            pending[pendingSize++] = size++;
+            return Error();
+        }
+
+        double code = node->value;
+        if (!(code >= 0 && code < TREE_OPERATORS_COUNT && code == (double)(size_t)code))
+            return CREATE_ERROR(ERROR_SYNTAX);
+
+        if (!copy->left || !copy->right)
+        {
+            // only ADD and SUB have a unary form
+            if (code != TREE_OPERATOR_ADD && code != TREE_OPERATOR_SUB)
+                return CREATE_ERROR(ERROR_SYNTAX);
+
+            copy->need = max(flat[copy->left + copy->right - 1].need, (size_t)1);
+        }
+        else
+        {
+            size_t left  = flat[copy->left  - 1].need;
+            size_t right = flat[copy->right - 1].need;
+
+            // the heavier side goes first and waits in one slot while the other one is computed
+            copy->need = left == right ? max(left + 1, (size_t)1) : max(left, right);
+        }
+
+        pending[pendingSize++] = size++;
+
+        return Error();
+    });
+
+    free(pending);
+
+    if (error)
+    {
+        free(flat);
+        return error;
+    }
+
+    *nodes = flat;
+    *count = size;
+
+    return Error();
+}
+
+/**
+ * @brief Writes the code of the flattened tree, the root being its last node
+ *
+ * Operands are emitted by an explicit stack of tasks, so deep trees are fine.
+ * A leaf is pushed only when it has no sibling to fold into, otherwise it
+ * becomes the operand of its parent's instruction.
+ */
+static Error _emit(const ExpressionNode* nodes, size_t count, TreeExpressionInstruction* code, size_t* size,
+                   size_t* stackSize)
+{
+    // a node is pushed once as a task to emit and once to apply
+    ExpressionTask* tasks = (ExpressionTask*)calloc(2 * count, sizeof(*tasks));
+    if (!tasks)
+        return CREATE_ERROR(ERROR_NO_MEMORY);
+
+    size_t tasksSize = 0;
+    size_t written   = 0;
+    size_t depth     = 0;
+    size_t maxDepth  = 0;
+
+    tasks[tasksSize++] = { count - 1, false };
+
+    while (tasksSize)
+    {
+        ExpressionTask        task = tasks[--tasksSize];
+        const ExpressionNode* node = &nodes[task.index];
+
+        const ExpressionNode* left  = node->left  ? &nodes[node->left  - 1] : nullptr;
+        const ExpressionNode* right = node->right ? &nodes[node->right - 1] : nullptr;
+
+        TreeExpressionOp op = (TreeExpressionOp)(TREE_EXPRESSION_ADD + (size_t)node->value);
+
+        if (!left && !right)
+        {
+            code[written++] = _leaf(TREE_EXPRESSION_PUSH, node->value);
+            maxDepth = max(maxDepth, ++depth);
+            continue;
+        }
+
+        if (!left || !right)
+        {
+            // _flatten let through only unary ADD, which is the identity, and SUB
+            if (task.apply)
+            {
+                if (op == TREE_EXPRESSION_SUB)
+                    code[written++] = { TREE_EXPRESSION_MUL, TREE_EXPRESSION_CONSTANT, false, -1, 0 };
+                continue;
+            }
+
+            tasks[tasksSize++] = { task.index, true };
+            tasks[tasksSize++] = { (size_t)((left ? left : right) - nodes), false };
+            continue;
+        }
+
+        bool leftLeaf   = !left->left  && !left->right;
+        bool rightLeaf  = !right->left && !right->right;
+        bool rightFirst = !rightLeaf && (leftLeaf || right->need > left->need);
+
+        if (task.apply)
+        {
+            if (rightLeaf)
+                code[written++] = _leaf(op, right->value);
+            else if (leftLeaf)
+            {
+                code[written] = _leaf(op, left->value);
+                code[written++].reversed = true;
+            }
+            else
+            {
+                code[written++] = { op, TREE_EXPRESSION_STACK, rightFirst, 0, 0 };
+                depth--;
+            }
+
+            continue;
+        }
+
+        tasks[tasksSize++] = { task.index, true };
+
+        if (rightLeaf)
+            tasks[tasksSize++] = { node->left - 1, false };
+        else if (leftLeaf)
+            tasks[tasksSize++] = { node->right - 1, false };
+        else if (rightFirst)
+        {
+            tasks[tasksSize++] = { node->left  - 1, false };
+            tasks[tasksSize++] = { node->right - 1, false };
+        }
+        else
+        {
+            tasks[tasksSize++] = { node->right - 1, false };
+            tasks[tasksSize++] = { node->left  - 1, false };
+        }
+    }
+
+    free(tasks);
+
+    *size      = written;
+    *stackSize = maxDepth;
+
+    return Error();
+}
+
+/**
+ * @brief Instruction op whose operand is the leaf with value
+ */
+static TreeExpressionInstruction _leaf(TreeExpressionOp op, double value)
+{
+    size_t column = 0;
+    if (TreeExpressionIsColumn(value, &column))
+        return { op, TREE_EXPRESSION_COLUMN, false, 0, column };
+
+    return { op, TREE_EXPRESSION_CONSTANT, false, value, 0 };
+}
+
+/**
+ * @brief Applies the operator of op to one pair of values
+ */
+template <TreeExpressionOp Op>
+static inline double _applyValue(double left, double right)
+{
+    if constexpr (Op == TREE_EXPRESSION_ADD)
+        return left + right;
+    else if constexpr (Op == TREE_EXPRESSION_SUB)
+        return left - right;
+    else if constexpr (Op == TREE_EXPRESSION_MUL)
+        return left * right;
+    else
+        return left / right;
+}
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+static inline ExpressionLanes _loadLanes(const double* values)
+{
+    #ifdef __AVX512F__
+    return _mm512_loadu_pd(values);
+    #else
+    return _mm256_loadu_pd(values);
+    #endif
+}
+
+static inline ExpressionLanes _broadcastLanes(double value)
+{
+    #ifdef __AVX512F__
+    return _mm512_set1_pd(value);
+    #else
+    return _mm256_set1_pd(value);
+    #endif
+}
+
+static inline void _storeLanes(double* values, ExpressionLanes lanes)
+{
+    #ifdef __AVX512F__
+    _mm512_storeu_pd(values, lanes);
+    #else
+    _mm256_storeu_pd(values, lanes);
+    #endif
+}
+
+/**
+ * @brief @ref _applyValue for a vector of values
+ */
+template <TreeExpressionOp Op>
+static inline ExpressionLanes _applyLanes(ExpressionLanes left, ExpressionLanes right)
+{
+    #ifdef __AVX512F__
+    if constexpr (Op == TREE_EXPRESSION_ADD)
+        return _mm512_add_pd(left, right);
+    else if constexpr (Op == TREE_EXPRESSION_SUB)
+        return _mm512_sub_pd(left, right);
+    else if constexpr (Op == TREE_EXPRESSION_MUL)
+        return _mm512_mul_pd(left, right);
+    else
+        return _mm512_div_pd(left, right);
+    #else
+    if constexpr (Op == TREE_EXPRESSION_ADD)
+        return _mm256_add_pd(left, right);
+    else if constexpr (Op == TREE_EXPRESSION_SUB)
+        return _mm256_sub_pd(left, right);
+    else if constexpr (Op == TREE_EXPRESSION_MUL)
+        return _mm256_mul_pd(left, right);
+    else
+        return _mm256_div_pd(left, right);
+    #endif
+}
+#endif
+
+/**
+ * @brief out = left op right for count rows, a missing side is the constant
+ */
+template <TreeExpressionOp Op, bool LeftConstant, bool RightConstant>
+static void _applyBlock(const double* left, const double* right, double constant, double* out, size_t count)
+{
+    size_t row = 0;
+
+    #if defined(__AVX512F__) || defined(__AVX2__)
+    ExpressionLanes broadcast = _broadcastLanes(constant);
+
+    for (; row + EXPRESSION_LANES <= count; row += EXPRESSION_LANES)
+    {
+        ExpressionLanes leftLanes  = LeftConstant  ? broadcast : _loadLanes(left  + row);
+        ExpressionLanes rightLanes = RightConstant ? broadcast : _loadLanes(right + row);
+
+        _storeLanes(out + row, _applyLanes<Op>(leftLanes, rightLanes));
+    }
+    #endif
+
+    for (; row < count; row++)
+        out[row] = _applyValue<Op>(LeftConstant ? constant : left[row], RightConstant ? constant : right[row]);
+}
+
+template <TreeExpressionOp Op>
+static void _applyOp(const double* left, const double* right, double constant, double* out, size_t count)
+{
+    if (!left)
+        _applyBlock<Op, true,  false>(left, right, constant, out, count);
+    else if (!right)
+        _applyBlock<Op, false, true >(left, right, constant, out, count);
+    else
+        _applyBlock<Op, false, false>(left, right, constant, out, count);
+}
+
+/**
+ * @brief out = left op right for count rows, nullptr for a side means the constant
+ */
+static void _apply(TreeExpressionOp op, const double* left, const double* right, double constant,
+                   double* out, size_t count)
+{
+    switch (op)
+    {
+        case TREE_EXPRESSION_ADD:
+            _applyOp<TREE_EXPRESSION_ADD>(left, right, constant, out, count);
+            break;
+        case TREE_EXPRESSION_SUB:
+            _applyOp<TREE_EXPRESSION_SUB>(left, right, constant, out, count);
+            break;
+        case TREE_EXPRESSION_MUL:
+            _applyOp<TREE_EXPRESSION_MUL>(left, right, constant, out, count);
+            break;
+        case TREE_EXPRESSION_DIV:
+            _applyOp<TREE_EXPRESSION_DIV>(left, right, constant, out, count);
+            break;
+        case TREE_EXPRESSION_PUSH:
+        default:
+            break;
+    }
+}
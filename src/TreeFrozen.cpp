@@ -0,0 +1,290 @@
+#include <stdlib.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include "TreeFrozen.hpp"
+#include "TreeWalk.hpp"
+#include "MinMax.hpp"
+
+static size_t _firstSlot(size_t size);
+
+static size_t _nextSlot(size_t slot, size_t size);
+
+template <typename T>
+static inline void _stepLanes(const T* values, size_t size, const T* keys, size_t* slots);
+
+#ifdef __AVX2__
+// element types whose lanes go down four at a time with AVX2 gathers
+template <typename T>
+static const bool HAS_AVX2_LANES = false;
+
+template <> const bool HAS_AVX2_LANES<double>  = true;
+template <> const bool HAS_AVX2_LANES<float>   = true;
+template <> const bool HAS_AVX2_LANES<int64_t> = true;
+template <> const bool HAS_AVX2_LANES<int32_t> = true;
+
+static inline __m256i _lessLanes(const double*  values, __m256i index, const double*  keys);
+static inline __m256i _lessLanes(const float*   values, __m256i index, const float*   keys);
+static inline __m256i _lessLanes(const int64_t* values, __m256i index, const int64_t* keys);
+static inline __m256i _lessLanes(const int32_t* values, __m256i index, const int32_t* keys);
+#endif
+
+template <typename T, typename Traits>
+Error BasicFrozenTree<T, Traits>::Init()
+{
+    this->values = nullptr;
+    this->size   = 0;
+
+    return Error();
+}
+
+template <typename T, typename Traits>
+Error BasicFrozenTree<T, Traits>::Destructor()
+{
+    free(this->values);
+
+    return this->Init();
+}
+
+template <typename T, typename Traits>
+Error BasicFrozenTree<T, Traits>::Freeze(Node* root)
+{
+    SoftAssert(root, ERROR_NULLPTR);
+
+    size_t count = 0;
+    RETURN_ERROR(TreePreOrder(root, [&count](Node*, size_t)
+    {
+        count++;
+        return Error();
+    }));
+
+    // aligned_alloc wants a whole number of lines
+    size_t bytes = ((count + 1) * sizeof(T) + TREE_CACHE_LINE_SIZE - 1) / TREE_CACHE_LINE_SIZE * TREE_CACHE_LINE_SIZE;
+
+    T* values = (T*)aligned_alloc(TREE_CACHE_LINE_SIZE, bytes);
+    if (!values)
+        return CREATE_ERROR(ERROR_NO_MEMORY);
+
+    values[0] = Traits::POISON;
+
+    // the pointer tree and the implicit one are walked in-order side by side
+    size_t slot     = _firstSlot(count);
+    T*     previous = nullptr;
+
+    Error error = TreeInOrder(root, [values, count, &slot, &previous](Node* node, size_t)
+    {
+        if (previous && node->value < *previous)
+            return CREATE_ERROR(ERROR_BAD_TREE);
+
+        values[slot] = node->value;
+        previous     = &values[slot];
+        slot         = _nextSlot(slot, count);
+
+        return Error();
+    });
+
+    if (error)
+    {
+        free(values);
+        return error;
+    }
+
+    free(this->values);
+    this->values = values;
+    this->size   = count;
+
+    return Error();
+}
+
+template <typename T, typename Traits>
+const T* BasicFrozenTree<T, Traits>::LowerBound(T value) const
+{
+    // descendants PREFETCH_STRIDE slots below k lie in one line starting at slot k * PREFETCH_STRIDE
+    static const size_t PREFETCH_STRIDE = TREE_CACHE_LINE_SIZE / sizeof(T);
+
+    const T* values = this->values;
+    size_t   size   = this->size;
+    size_t   slot   = 1;
+
+    while (slot <= size)
+    {
+        __builtin_prefetch(values + slot * PREFETCH_STRIDE);
+        slot = 2 * slot + (values[slot] < value);
+    }
+
+    // the trailing ones are the steps right after the last step left, which was at the answer
+    slot >>= __builtin_ctzll(~(unsigned long long)slot) + 1;
+
+    return slot ? values + slot : nullptr;
+}
+
+template <typename T, typename Traits>
+const T* BasicFrozenTree<T, Traits>::Find(T value) const
+{
+    const T* found = this->LowerBound(value);
+    if (!found || value < *found)
+        return nullptr;
+
+    return found;
+}
+
+template <typename T, typename Traits>
+Error BasicFrozenTree<T, Traits>::LowerBoundBatch(const T* keys, size_t count, const T** found) const
+{
+    SoftAssert(keys,  ERROR_NULLPTR);
+    SoftAssert(found, ERROR_NULLPTR);
+
+    const T* values = this->values;
+    size_t   size   = this->size;
+
+    size_t levels = 0;
+    for (size_t rest = size; rest; rest >>= 1)
+        levels++;
+
+    for (size_t first = 0; first < count; first += TREE_BATCH_LANES)
+    {
+        size_t lanes = min(count - first, TREE_BATCH_LANES);
+
+        // a short last group repeats its last key, so every group is full width
+        T      laneKeys[TREE_BATCH_LANES] = {};
+        size_t slots[TREE_BATCH_LANES]    = {};
+        for (size_t lane = 0; lane < TREE_BATCH_LANES; lane++)
+        {
+            laneKeys[lane] = keys[first + min(lane, lanes - 1)];
+            slots[lane]    = 1;
+        }
+
+        for (size_t level = 0; level < levels; level++)
+            _stepLanes(values, size, laneKeys, slots);
+
+        for (size_t lane = 0; lane < lanes; lane++)
+        {
+            size_t slot = slots[lane] >> (__builtin_ctzll(~(unsigned long long)slots[lane]) + 1);
+            found[first + lane] = slot ? values + slot : nullptr;
+        }
+    }
+
+    return Error();
+}
+
+template <typename T, typename Traits>
+Error BasicFrozenTree<T, Traits>::FindBatch(const T* keys, size_t count, const T** found) const
+{
+    RETURN_ERROR(this->LowerBoundBatch(keys, count, found));
+
+    for (size_t key = 0; key < count; key++)
+        if (found[key] && keys[key] < *found[key])
+            found[key] = nullptr;
+
+    return Error();
+}
+
+/**
+ * @brief Moves every lane one level down, a lane which fell out of the bottom
+ * reads slot 0 and stays where it is
+ */
+template <typename T>
+static inline void _stepLanes(const T* values, size_t size, const T* keys, size_t* slots)
+{
+    #ifdef __AVX2__
+    if constexpr (HAS_AVX2_LANES<T>)
+    {
+        // slots stay far below 2^63, so the signed compare is right
+        const __m256i bottom = _mm256_set1_epi64x((long long)size + 1);
+
+        for (size_t lane = 0; lane < TREE_BATCH_LANES; lane += 4)
+        {
+            __m256i slot   = _mm256_loadu_si256((const __m256i*)(slots + lane));
+            __m256i inside = _mm256_cmpgt_epi64(bottom, slot);
+            __m256i less   = _lessLanes(values, _mm256_and_si256(slot, inside), keys + lane);
+
+            // less is -1 where the value is smaller, then the lane goes right
+            __m256i next = _mm256_sub_epi64(_mm256_add_epi64(slot, slot), less);
+
+            _mm256_storeu_si256((__m256i*)(slots + lane), _mm256_blendv_epi8(slot, next, inside));
+        }
+
+        return;
+    }
+    #endif
+
+    for (size_t lane = 0; lane < TREE_BATCH_LANES; lane++)
+    {
+        size_t slot   = slots[lane];
+        bool   inside = slot <= size;
+        T      value  = values[inside ? slot : 0];
+
+        slots[lane] = inside ? 2 * slot + (value < keys[lane]) : slot;
+    }
+}
+
+#ifdef __AVX2__
+/**
+ * @brief Gathers values at four slots and compares them with four keys,
+ * a lane is -1 if its value is less than its key and 0 otherwise
+ */
+static inline __m256i _lessLanes(const double* values, __m256i index, const double* keys)
+{
+    __m256d value = _mm256_i64gather_pd(values, index, sizeof(*values));
+
+    return _mm256_castpd_si256(_mm256_cmp_pd(value, _mm256_loadu_pd(keys), _CMP_LT_OQ));
+}
+
+static inline __m256i _lessLanes(const float* values, __m256i index, const float* keys)
+{
+    __m128 value = _mm256_i64gather_ps(values, index, sizeof(*values));
+
+    return _mm256_cvtepi32_epi64(_mm_castps_si128(_mm_cmplt_ps(value, _mm_loadu_ps(keys))));
+}
+
+static inline __m256i _lessLanes(const int64_t* values, __m256i index, const int64_t* keys)
+{
+    __m256i value = _mm256_i64gather_epi64((const long long*)values, index, sizeof(*values));
+
+    return _mm256_cmpgt_epi64(_mm256_loadu_si256((const __m256i*)keys), value);
+}
+
+static inline __m256i _lessLanes(const int32_t* values, __m256i index, const int32_t* keys)
+{
+    __m128i value = _mm256_i64gather_epi32((const int*)values, index, sizeof(*values));
+
+    return _mm256_cvtepi32_epi64(_mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*)keys), value));
+}
+#endif
+
+/**
+ * @brief Slot of the leftmost node of an implicit tree of size slots
+ */
+static size_t _firstSlot(size_t size)
+{
+    size_t slot = 1;
+    while (2 * slot <= size)
+        slot *= 2;
+
+    return slot;
+}
+
+/**
+ * @brief Slot which follows slot in-order, 0 after the last one
+ */
+static size_t _nextSlot(size_t slot, size_t size)
+{
+    if (2 * slot + 1 <= size)
+    {
+        slot = 2 * slot + 1;
+        while (2 * slot <= size)
+            slot *= 2;
+
+        return slot;
+    }
+
+    // climb while coming from the right
+    while (slot & 1)
+        slot >>= 1;
+
+    return slot >> 1;
+}
+
+#define INSTANTIATE_FROZEN(T) template struct BasicFrozenTree<T>;
+TREE_ELEMENT_TYPES(INSTANTIATE_FROZEN)
+#undef INSTANTIATE_FROZEN
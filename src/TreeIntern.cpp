@@ -0,0 +1,546 @@
+#include <stdlib.h>
+#include <string.h>
+#include "TreeIntern.hpp"
+#include "TreeBinary.hpp"
+#include "TreeWalk.hpp"
+
+/** @struct TreeInternSlab
+ * @brief Block of nodes of a @ref BasicInternTable, nodes follow the header
+ */
+struct TreeInternSlab
+{
+    TreeInternSlab* next;
+    size_t          used;
+};
+
+template <typename Node>
+static const size_t INTERN_SLAB_HEADER_SIZE = (sizeof(TreeInternSlab) + alignof(Node) - 1) / alignof(Node) * alignof(Node);
+template <typename Node>
+static const size_t NODES_PER_INTERN_SLAB   = (TREE_SLAB_SIZE - INTERN_SLAB_HEADER_SIZE<Node>) / sizeof(Node);
+
+static const size_t INTERN_MIN_CAPACITY = 64;
+
+static inline uint64_t _mix(uint64_t x);
+
+template <typename T, typename Node>
+static uint64_t _hash(T value, const Node* left, const Node* right);
+
+template <typename Table>
+static Error _rehash(Table* table);
+
+template <typename Table>
+static typename Table::Node* _allocate(Table* table);
+
+template <typename Node, typename Func>
+static Error _forEachUnique(const Node* root, uint32_t* marks, Func func);
+
+template <typename T>
+static Error _grow(T** array, size_t* capacity, size_t size);
+
+template <typename T, typename Traits>
+Error BasicInternTable<T, Traits>::Init()
+{
+    this->slots    = nullptr;
+    this->capacity = 0;
+    this->count    = 0;
+    this->slabs    = nullptr;
+
+    return Error();
+}
+
+template <typename T, typename Traits>
+Error BasicInternTable<T, Traits>::Destructor()
+{
+    TreeInternSlab* slab = this->slabs;
+    while (slab)
+    {
+        TreeInternSlab* next = slab->next;
+        free(slab);
+        slab = next;
+    }
+
+    free(this->slots);
+
+    return this->Init();
+}
+
+template <typename T, typename Traits>
+typename BasicInternTable<T, Traits>::Node::Result BasicInternTable<T, Traits>::Make(T value, const Node* left,
+                                                                                    const Node* right)
+{
+    // the table is kept at most half full, so probes stay short
+    if ((this->count + 1) * 2 > this->capacity)
+    {
+        Error error = _rehash(this);
+        if (error)
+            return { nullptr, error };
+    }
+
+    uint64_t hash = _hash(value, left, right);
+    size_t   mask = this->capacity - 1;
+    size_t   slot = hash & mask;
+
+    for (; this->slots[slot]; slot = (slot + 1) & mask)
+    {
+        const Node* node = this->slots[slot];
+
+        if (node->hash == hash && node->left == left && node->right == right &&
+            memcmp(&node->value, &value, sizeof(value)) == 0)
+            return { node, Error() };
+    }
+
+    Node* node = _allocate(this);
+    if (!node)
+        return { nullptr, CREATE_ERROR(ERROR_NO_MEMORY) };
+
+    node->left  = left;
+    node->right = right;
+    node->value = value;
+    node->hash  = hash;
+    node->id    = this->count++;
+
+    this->slots[slot] = node;
+
+    return { node, Error() };
+}
+
+template <typename T, typename Traits>
+typename BasicInternTable<T, Traits>::Node::Result BasicInternTable<T, Traits>::FromTree(const PointerTree* tree)
+{
+    SoftAssertResult(tree, nullptr, ERROR_NULLPTR);
+
+    typedef typename PointerTree::Node TreeNode;
+
+    // made subtrees wait on the stack for their parent, the right one on top
+    const Node** stack     = nullptr;
+    size_t       capacity  = 0;
+    size_t       stackSize = 0;
+
+    Error error = TreePostOrder(tree->root, [this, &stack, &capacity, &stackSize](TreeNode* node, size_t)
+    {
+        const Node* right = node->right ? stack[--stackSize] : nullptr;
+        const Node* left  = node->left  ? stack[--stackSize] : nullptr;
+
+        typename Node::Result nodeRes = this->Make(node->value, left, right);
+        RETURN_ERROR(nodeRes.error);
+        RETURN_ERROR(_grow(&stack, &capacity, stackSize + 1));
+
+        stack[stackSize++] = nodeRes.value;
+
+        return Error();
+    });
+
+    const Node* root = error ? nullptr : stack[0];
+    free(stack);
+
+    return { root, error };
+}
+
+template <typename T, typename Traits>
+Error BasicInternTable<T, Traits>::ToTree(const Node* root, PointerTree* tree) const
+{
+    SoftAssert(root, ERROR_NO_ROOT);
+    SoftAssert(tree, ERROR_NULLPTR);
+
+    typedef typename PointerTree::Node TreeNode;
+    typedef typename PointerTree::Pool Pool;
+
+    /** @struct Pending
+     * @brief Node to copy under parent
+     */
+    struct Pending
+    {
+        const Node* node;
+        TreeNode*   parent;
+        bool        isLeft;
+    };
+
+    Pool* pool = (Pool*)calloc(1, sizeof(*pool));
+    if (!pool)
+        return CREATE_ERROR(ERROR_NO_MEMORY);
+    pool->Init();
+
+    Pending*  stack     = nullptr;
+    size_t    capacity  = 0;
+    size_t    stackSize = 0;
+    TreeNode* treeRoot  = nullptr;
+
+    Error error = _grow(&stack, &capacity, 1);
+    if (!error)
+        stack[stackSize++] = { root, nullptr, false };
+
+    while (stackSize && !error)
+    {
+        Pending top = stack[--stackSize];
+
+        typename TreeNode::Result nodeRes = TreeNode::New(top.node->value, nullptr, nullptr, pool);
+        error = nodeRes.error;
+        if (error)
+            break;
+
+        TreeNode* node = nodeRes.value;
+
+        // sizes of inner nodes are recounted when asked for
+        #ifdef TREE_SUBTREE_SIZES
+        if (top.node->left || top.node->right)
+            node->nodeCount = TREE_SIZE_STALE;
+        #endif
+
+        if (!top.parent)
+            treeRoot = node;
+        else if (top.isLeft)
+            top.parent->left  = node;
+        else
+            top.parent->right = node;
+        node->parent = top.parent;
+
+        error = _grow(&stack, &capacity, stackSize + 2);
+        if (error)
+            break;
+
+        if (top.node->right)
+            stack[stackSize++] = { top.node->right, node, false };
+        if (top.node->left)
+            stack[stackSize++] = { top.node->left,  node, true };
+    }
+
+    free(stack);
+
+    if (error)
+    {
+        pool->Destructor();
+        free(pool);
+        return error;
+    }
+
+    tree->root = treeRoot;
+    tree->pool = pool;
+
+    return Error();
+}
+
+template <typename T, typename Traits>
+TreeNodeCountResult BasicInternTable<T, Traits>::CountUnique(const Node* root) const
+{
+    SoftAssertResult(root, SIZET_POISON, ERROR_NO_ROOT);
+
+    uint32_t* marks = (uint32_t*)calloc(this->count, sizeof(*marks));
+    if (!marks)
+        return { SIZET_POISON, CREATE_ERROR(ERROR_NO_MEMORY) };
+
+    size_t count = 0;
+    Error  error = _forEachUnique(root, marks, [&count](const Node*)
+    {
+        count++;
+        return Error();
+    });
+
+    free(marks);
+
+    if (error)
+        return { SIZET_POISON, error };
+
+    return { count, Error() };
+}
+
+template <typename T, typename Traits>
+Error BasicInternTable<T, Traits>::WriteBinary(const Node* root, const char* outPath) const
+{
+    SoftAssert(root,    ERROR_NO_ROOT);
+    SoftAssert(outPath, ERROR_NULLPTR);
+
+    TreeNodeCountResult countRes = this->CountUnique(root);
+    RETURN_ERROR(countRes.error);
+
+    uint32_t* marks   = (uint32_t*)calloc(this->count, sizeof(*marks));
+    FILE*     outFile = fopen(outPath, "wb");
+
+    if (!marks || !outFile)
+    {
+        free(marks);
+        if (outFile)
+            fclose(outFile);
+        return !marks ? CREATE_ERROR(ERROR_NO_MEMORY) : CREATE_ERROR(ERROR_BAD_FILE);
+    }
+
+    TreeBinaryHeader header = {};
+    memcpy(header.signature, TREE_DAG_SIGNATURE, sizeof(header.signature));
+    header.version     = TREE_DAG_VERSION;
+    header.elementSize = sizeof(T);
+    header.elementKind = Traits::KIND;
+    header.nodeCount   = countRes.value;
+
+    Error error = Error();
+    if (fwrite(&header, sizeof(header), 1, outFile) != 1)
+        error = CREATE_ERROR(ERROR_BAD_FILE);
+
+    // a mark is the index of the node in the file plus one, just what a record keeps
+    if (!error)
+        error = _forEachUnique(root, marks, [marks, outFile](const Node* node)
+        {
+            uint32_t left  = node->left  ? marks[node->left->id]  : 0;
+            uint32_t right = node->right ? marks[node->right->id] : 0;
+
+            if (fwrite(&left,        sizeof(left),        1, outFile) != 1 ||
+                fwrite(&right,       sizeof(right),       1, outFile) != 1 ||
+                fwrite(&node->value, sizeof(node->value), 1, outFile) != 1)
+                return CREATE_ERROR(ERROR_BAD_FILE);
+
+            return Error();
+        });
+
+    free(marks);
+
+    if (fclose(outFile) != 0 && !error)
+        error = CREATE_ERROR(ERROR_BAD_FILE);
+
+    return error;
+}
+
+template <typename T, typename Traits>
+typename BasicInternTable<T, Traits>::Node::Result BasicInternTable<T, Traits>::ReadBinary(const char* readPath)
+{
+    SoftAssertResult(readPath, nullptr, ERROR_NULLPTR);
+
+    FILE* readFile = fopen(readPath, "rb");
+    if (!readFile)
+        return { nullptr, CREATE_ERROR(ERROR_BAD_FILE) };
+
+    TreeBinaryHeader header = {};
+    if (fread(&header, sizeof(header), 1, readFile) != 1 ||
+        memcmp(header.signature, TREE_DAG_SIGNATURE, sizeof(header.signature)) != 0 ||
+        header.version     != TREE_DAG_VERSION ||
+        header.elementSize != sizeof(T) ||
+        header.elementKind != Traits::KIND ||
+        header.nodeCount   == 0 || header.nodeCount > UINT32_MAX)
+    {
+        fclose(readFile);
+        return { nullptr, CREATE_ERROR(ERROR_BAD_FILE) };
+    }
+
+    const Node** nodes = (const Node**)calloc(header.nodeCount, sizeof(*nodes));
+    if (!nodes)
+    {
+        fclose(readFile);
+        return { nullptr, CREATE_ERROR(ERROR_NO_MEMORY) };
+    }
+
+    Error error = Error();
+    for (size_t index = 0; index < header.nodeCount && !error; index++)
+    {
+        uint32_t left  = 0;
+        uint32_t right = 0;
+        T        value = {};
+
+        // children come first, so an index must point back
+        if (fread(&left,  sizeof(left),  1, readFile) != 1 ||
+            fread(&right, sizeof(right), 1, readFile) != 1 ||
+            fread(&value, sizeof(value), 1, readFile) != 1 ||
+            left > index || right > index)
+        {
+            error = CREATE_ERROR(ERROR_BAD_FILE);
+            break;
+        }
+
+        typename Node::Result nodeRes = this->Make(value, left  ? nodes[left  - 1] : nullptr,
+                                                          right ? nodes[right - 1] : nullptr);
+        error        = nodeRes.error;
+        nodes[index] = nodeRes.value;
+    }
+
+    const Node* root = error ? nullptr : nodes[header.nodeCount - 1];
+
+    free(nodes);
+    fclose(readFile);
+
+    return { root, error };
+}
+
+/**
+ * @brief Finalizer of MurmurHash3, spreads every bit of x over the whole result
+ */
+static inline uint64_t _mix(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+
+    return x;
+}
+
+/**
+ * @brief Hash of the value bits and the hashes of the children, left and right differ
+ */
+template <typename T, typename Node>
+static uint64_t _hash(T value, const Node* left, const Node* right)
+{
+    static_assert(sizeof(T) <= sizeof(uint64_t), "the value is hashed as one 64 bit word");
+
+    uint64_t bits = 0;
+    memcpy(&bits, &value, sizeof(value));
+
+    uint64_t hash = _mix(bits ^ 0x9e3779b97f4a7c15ull);
+    hash = _mix(hash ^ (left  ? left->hash  : 1) * 0xbf58476d1ce4e5b9ull);
+    hash = _mix(hash ^ (right ? right->hash : 2) * 0x94d049bb133111ebull);
+
+    return hash;
+}
+
+/**
+ * @brief Doubles the slots and puts every node back by its hash
+ */
+template <typename Table>
+static Error _rehash(Table* table)
+{
+    typedef typename Table::Node Node;
+
+    size_t capacity = table->capacity ? 2 * table->capacity : INTERN_MIN_CAPACITY;
+
+    const Node** slots = (const Node**)calloc(capacity, sizeof(*slots));
+    if (!slots)
+        return CREATE_ERROR(ERROR_NO_MEMORY);
+
+    size_t mask = capacity - 1;
+    for (size_t old = 0; old < table->capacity; old++)
+    {
+        const Node* node = table->slots[old];
+        if (!node)
+            continue;
+
+        size_t slot = node->hash & mask;
+        while (slots[slot])
+            slot = (slot + 1) & mask;
+
+        slots[slot] = node;
+    }
+
+    free(table->slots);
+    table->slots    = slots;
+    table->capacity = capacity;
+
+    return Error();
+}
+
+/**
+ * @brief Cuts a node from the newest slab, nullptr if out of memory
+ */
+template <typename Table>
+static typename Table::Node* _allocate(Table* table)
+{
+    typedef typename Table::Node Node;
+
+    TreeInternSlab* slab = table->slabs;
+    if (!slab || slab->used == NODES_PER_INTERN_SLAB<Node>)
+    {
+        slab = (TreeInternSlab*)malloc(TREE_SLAB_SIZE);
+        if (!slab)
+            return nullptr;
+
+        slab->next   = table->slabs;
+        slab->used   = 0;
+        table->slabs = slab;
+    }
+
+    return (Node*)((char*)slab + INTERN_SLAB_HEADER_SIZE<Node>) + slab->used++;
+}
+
+/**
+ * @brief Calls func(node) once for every distinct node under root, children first
+ *
+ * marks has an element per node of the table, zeroed. A visited node gets
+ * its number in the walk plus one.
+ */
+template <typename Node, typename Func>
+static Error _forEachUnique(const Node* root, uint32_t* marks, Func func)
+{
+    /** @struct Pending
+     * @brief Node waiting for its children, expanded once they are on the stack
+     */
+    struct Pending
+    {
+        const Node* node;
+        bool        expanded;
+    };
+
+    Pending* stack     = nullptr;
+    size_t   capacity  = 0;
+    size_t   stackSize = 0;
+    uint32_t visited   = 0;
+
+    Error error = _grow(&stack, &capacity, 1);
+    if (!error)
+        stack[stackSize++] = { root, false };
+
+    while (stackSize && !error)
+    {
+        Pending*    top  = &stack[stackSize - 1];
+        const Node* node = top->node;
+
+        // a shared node may wait on the stack twice
+        if (marks[node->id])
+        {
+            stackSize--;
+            continue;
+        }
+
+        if (!top->expanded)
+        {
+            top->expanded = true;
+
+            error = _grow(&stack, &capacity, stackSize + 2);
+            if (error)
+                break;
+
+            if (node->right && !marks[node->right->id])
+                stack[stackSize++] = { node->right, false };
+            if (node->left && !marks[node->left->id])
+                stack[stackSize++] = { node->left,  false };
+
+            continue;
+        }
+
+        stackSize--;
+
+        if (visited == UINT32_MAX)
+        {
+            error = CREATE_ERROR(ERROR_BAD_SIZE);
+            break;
+        }
+
+        marks[node->id] = ++visited;
+        error = func(node);
+    }
+
+    free(stack);
+
+    return error;
+}
+
+/**
+ * @brief Makes room for size elements, at least doubling the array
+ */
+template <typename T>
+static Error _grow(T** array, size_t* capacity, size_t size)
+{
+    if (size <= *capacity)
+        return Error();
+
+    size_t newCapacity = *capacity ? 2 * *capacity : 64;
+    while (newCapacity < size)
+        newCapacity *= 2;
+
+    T* newArray = (T*)realloc(*array, newCapacity * sizeof(**array));
+    if (!newArray)
+        return CREATE_ERROR(ERROR_NO_MEMORY);
+
+    *array    = newArray;
+    *capacity = newCapacity;
+
+    return Error();
+}
+
+#define INSTANTIATE_INTERN(T) template struct BasicInternTable<T>;
+TREE_ELEMENT_TYPES(INSTANTIATE_INTERN)
+#undef INSTANTIATE_INTERN
@@ -0,0 +1,331 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "Tree.hpp"
+
+template <typename Pool>
+static const size_t SLAB_HEADER_SIZE = (sizeof(typename Pool::Slab) + alignof(typename Pool::Node) - 1) /
+                                       alignof(typename Pool::Node) * alignof(typename Pool::Node);
+template <typename Pool>
+static const size_t NODES_PER_SLAB   = (TREE_SLAB_SIZE - SLAB_HEADER_SIZE<Pool>) / sizeof(typename Pool::Node);
+
+template <typename Pool>
+static Pool SHARED_POOL = {};
+
+template <typename Pool>
+static pthread_mutex_t SHARED_MUTEX = PTHREAD_MUTEX_INITIALIZER;
+
+/** @struct TreeNodeCache
+ * @brief Nodes of the shared pool kept by one thread, linked through left
+ */
+template <typename Pool>
+struct TreeNodeCache
+{
+    typename Pool::Node* nodes;
+    size_t               count;
+};
+
+template <typename Pool>
+static thread_local TreeNodeCache<Pool> CACHE = {};
+
+template <typename Pool>
+static typename Pool::Node* _take(Pool* pool);
+
+template <typename Pool>
+static typename Pool::Node* _takeCached(Pool* pool);
+
+template <typename Pool>
+static void _giveCached(Pool* pool, typename Pool::Node* node);
+
+template <typename Pool>
+static inline typename Pool::Node* _slabNodes(typename Pool::Slab* slab)
+{
+    return (typename Pool::Node*)((char*)slab + SLAB_HEADER_SIZE<Pool>);
+}
+
+template <typename T, typename Traits>
+Error BasicTreeNodePool<T, Traits>::Init()
+{
+    this->slabs      = nullptr;
+    this->freeList   = nullptr;
+    this->slabCount  = 0;
+    this->nodesInUse = 0;
+
+    return Error();
+}
+
+template <typename T, typename Traits>
+Error BasicTreeNodePool<T, Traits>::Destructor()
+{
+    // caches of other threads are left dangling, they must not use the pool anymore
+    if (this == Shared())
+        CACHE<BasicTreeNodePool> = {};
+
+    Slab* slab = this->slabs;
+    while (slab)
+    {
+        Slab* next = slab->next;
+        free(slab);
+        slab = next;
+    }
+
+    return this->Init();
+}
+
+template <typename T, typename Traits>
+BasicTreeNodeResult<T, Traits> BasicTreeNodePool<T, Traits>::Allocate()
+{
+    Node* node = this == Shared() ? _takeCached(this) : _take(this);
+    if (!node)
+        return { nullptr, CREATE_ERROR(ERROR_NO_MEMORY) };
+
+    memset(node, 0, sizeof(*node));
+
+    return { node, Error() };
+}
+
+/**
+ * @brief Takes a node from the free list or cuts a new one, nullptr if out of memory
+ */
+template <typename Pool>
+static typename Pool::Node* _take(Pool* pool)
+{
+    typedef typename Pool::Node Node;
+    typedef typename Pool::Slab Slab;
+
+    Node* node = pool->freeList;
+
+    if (node)
+        pool->freeList = node->left;
+    else
+    {
+        Slab* slab = pool->slabs;
+        if (!slab || slab->used == NODES_PER_SLAB<Pool>)
+        {
+            uint64_t start = TreeStatsStart();
+
+            slab = (Slab*)aligned_alloc(TREE_SLAB_SIZE, TREE_SLAB_SIZE);
+            if (!slab)
+                return nullptr;
+
+            TreeStatsEnd(TREE_STATS_ALLOCATE_SLAB, start);
+            TreeStatsAdd(TREE_STATS_ALLOCATE_SLAB, 0, TREE_SLAB_SIZE);
+
+            slab->pool = pool;
+            slab->next = pool->slabs;
+            slab->used = 0;
+
+            pool->slabs = slab;
+            pool->slabCount++;
+        }
+
+        node = _slabNodes<Pool>(slab) + slab->used++;
+    }
+
+    pool->nodesInUse++;
+
+    return node;
+}
+
+/**
+ * @brief Takes a node from the thread's cache, refilling it from the shared pool
+ * with @ref TREE_NODE_CACHE_SIZE nodes under one lock
+ */
+template <typename Pool>
+static typename Pool::Node* _takeCached(Pool* pool)
+{
+    typedef typename Pool::Node Node;
+
+    TreeNodeCache<Pool>& cache = CACHE<Pool>;
+
+    if (!cache.count)
+    {
+        pthread_mutex_lock(&SHARED_MUTEX<Pool>);
+
+        while (cache.count < TREE_NODE_CACHE_SIZE)
+        {
+            Node* node = _take(pool);
+            if (!node)
+                break;
+
+            node->left  = cache.nodes;
+            cache.nodes = node;
+            cache.count++;
+        }
+
+        pthread_mutex_unlock(&SHARED_MUTEX<Pool>);
+
+        if (!cache.count)
+            return nullptr;
+    }
+
+    Node* node = cache.nodes;
+    cache.nodes = node->left;
+    cache.count--;
+
+    return node;
+}
+
+/**
+ * @brief Puts a node of the shared pool to the thread's cache, when the cache
+ * holds twice @ref TREE_NODE_CACHE_SIZE nodes half of them go back under one lock
+ */
+template <typename Pool>
+static void _giveCached(Pool* pool, typename Pool::Node* node)
+{
+    typedef typename Pool::Node Node;
+
+    TreeNodeCache<Pool>& cache = CACHE<Pool>;
+
+    node->left  = cache.nodes;
+    cache.nodes = node;
+    cache.count++;
+
+    if (cache.count < 2 * TREE_NODE_CACHE_SIZE)
+        return;
+
+    Node* head = cache.nodes;
+    Node* tail = head;
+    for (size_t i = 1; i < TREE_NODE_CACHE_SIZE; i++)
+        tail = tail->left;
+
+    cache.nodes  = tail->left;
+    cache.count -= TREE_NODE_CACHE_SIZE;
+
+    pthread_mutex_lock(&SHARED_MUTEX<Pool>);
+
+    tail->left        = pool->freeList;
+    pool->freeList    = head;
+    pool->nodesInUse -= TREE_NODE_CACHE_SIZE;
+
+    pthread_mutex_unlock(&SHARED_MUTEX<Pool>);
+}
+
+template <typename T, typename Traits>
+Error BasicTreeNodePool<T, Traits>::Merge(BasicTreeNodePool* other)
+{
+    SoftAssert(other, ERROR_NULLPTR);
+
+    if (other == this || !other->slabs)
+        return Error();
+
+    // only the shared pool is used by several threads, the other one is not locked
+    pthread_mutex_t* mutex = this == Shared() ? &SHARED_MUTEX<BasicTreeNodePool> : nullptr;
+    if (other == Shared())
+        mutex = &SHARED_MUTEX<BasicTreeNodePool>;
+    if (mutex)
+        pthread_mutex_lock(mutex);
+
+    // the newest slab stays first, so allocation goes on where this pool stopped
+    Slab* last = other->slabs;
+    while (true)
+    {
+        last->pool = this;
+        if (!last->next)
+            break;
+        last = last->next;
+    }
+
+    if (this->slabs)
+    {
+        last->next        = this->slabs->next;
+        this->slabs->next = other->slabs;
+    }
+    else
+        this->slabs = other->slabs;
+
+    Node* freeList = other->freeList;
+    while (freeList)
+    {
+        Node* next = freeList->left;
+        freeList->left = this->freeList;
+        this->freeList = freeList;
+        freeList = next;
+    }
+
+    this->slabCount  += other->slabCount;
+    this->nodesInUse += other->nodesInUse;
+
+    other->Init();
+
+    if (mutex)
+        pthread_mutex_unlock(mutex);
+
+    return Error();
+}
+
+template <typename T, typename Traits>
+Error BasicTreeNodePool<T, Traits>::Free(Node* node)
+{
+    SoftAssert(node, ERROR_NULLPTR);
+
+    BasicTreeNodePool* pool = BasicTreeNodePool::Of(node);
+
+    if (pool == Shared())
+    {
+        _giveCached(pool, node);
+        return Error();
+    }
+
+    node->left     = pool->freeList;
+    pool->freeList = node;
+    pool->nodesInUse--;
+
+    return Error();
+}
+
+template <typename T, typename Traits>
+Error BasicTreeNodePool<T, Traits>::FreeChain(Node* head, Node* tail, size_t count)
+{
+    SoftAssert(head, ERROR_NULLPTR);
+    SoftAssert(tail, ERROR_NULLPTR);
+
+    bool shared = this == Shared();
+    if (shared)
+        pthread_mutex_lock(&SHARED_MUTEX<BasicTreeNodePool>);
+
+    tail->left     = this->freeList;
+    this->freeList = head;
+    this->nodesInUse -= count;
+
+    if (shared)
+        pthread_mutex_unlock(&SHARED_MUTEX<BasicTreeNodePool>);
+
+    return Error();
+}
+
+template <typename T, typename Traits>
+Error BasicTreeNodePool<T, Traits>::ReleaseCache()
+{
+    TreeNodeCache<BasicTreeNodePool>& cache = CACHE<BasicTreeNodePool>;
+    if (!cache.count)
+        return Error();
+
+    Node* tail = cache.nodes;
+    while (tail->left)
+        tail = tail->left;
+
+    Error error = Shared()->FreeChain(cache.nodes, tail, cache.count);
+    cache = {};
+
+    return error;
+}
+
+template <typename T, typename Traits>
+BasicTreeNodePool<T, Traits>* BasicTreeNodePool<T, Traits>::Of(const Node* node)
+{
+    Slab* slab = (Slab*)((uintptr_t)node & ~(TREE_SLAB_SIZE - 1));
+
+    return slab->pool;
+}
+
+template <typename T, typename Traits>
+BasicTreeNodePool<T, Traits>* BasicTreeNodePool<T, Traits>::Shared()
+{
+    return &SHARED_POOL<BasicTreeNodePool>;
+}
+
+#define INSTANTIATE_POOL(T) template struct BasicTreeNodePool<T>;
+TREE_ELEMENT_TYPES(INSTANTIATE_POOL)
+#undef INSTANTIATE_POOL
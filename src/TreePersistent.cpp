@@ -0,0 +1,419 @@
+#include <stdlib.h>
+#include <string.h>
+#include "TreePersistent.hpp"
+#include "TreeWalk.hpp"
+
+template <typename Node>
+static Error _checkPath(const char* path, size_t* length);
+
+template <typename Node>
+static Node* _follow(Node* node, const char* path, size_t steps);
+
+template <typename Node>
+static Error _copyPath(Node* root, const char* path, size_t steps, Node** newRoot, Node** last);
+
+template <typename Node>
+static void _retain(Node* node);
+
+template <typename Node>
+static void _release(Node* node);
+
+template <typename T>
+static Error _grow(T** array, size_t* capacity, size_t size);
+
+template <typename T, typename Traits>
+Error BasicPersistentTree<T, Traits>::Init()
+{
+    this->root = nullptr;
+
+    return Error();
+}
+
+template <typename T, typename Traits>
+Error BasicPersistentTree<T, Traits>::Destructor()
+{
+    _release(this->root);
+
+    return this->Init();
+}
+
+template <typename T, typename Traits>
+Error BasicPersistentTree<T, Traits>::Snapshot(BasicPersistentTree* snapshot) const
+{
+    SoftAssert(snapshot, ERROR_NULLPTR);
+
+    _retain(this->root);
+    snapshot->root = this->root;
+
+    return Error();
+}
+
+template <typename T, typename Traits>
+const typename BasicPersistentTree<T, Traits>::Node* BasicPersistentTree<T, Traits>::At(const char* path) const
+{
+    size_t length = 0;
+    if (_checkPath<Node>(path, &length))
+        return nullptr;
+
+    return _follow(this->root, path, length);
+}
+
+template <typename T, typename Traits>
+Error BasicPersistentTree<T, Traits>::Set(const char* path, T value)
+{
+    size_t length = 0;
+    RETURN_ERROR(_checkPath<Node>(path, &length));
+
+    // only the last step may lead to a missing node
+    if (length > 0 && !_follow(this->root, path, length - 1))
+        return CREATE_ERROR(ERROR_NULLPTR);
+
+    Node* newRoot = nullptr;
+    Node* last    = nullptr;
+    RETURN_ERROR(_copyPath(this->root, path, length, &newRoot, &last));
+
+    last->value = value;
+
+    _release(this->root);
+    this->root = newRoot;
+
+    return Error();
+}
+
+template <typename T, typename Traits>
+Error BasicPersistentTree<T, Traits>::Remove(const char* path)
+{
+    size_t length = 0;
+    RETURN_ERROR(_checkPath<Node>(path, &length));
+
+    if (!_follow(this->root, path, length))
+        return CREATE_ERROR(ERROR_NULLPTR);
+
+    if (length == 0)
+        return this->Destructor();
+
+    Node* newRoot = nullptr;
+    Node* parent  = nullptr;
+    RETURN_ERROR(_copyPath(this->root, path, length - 1, &newRoot, &parent));
+
+    Node** link = path[length - 1] == 'R' ? &parent->right : &parent->left;
+    _release(*link);
+    *link = nullptr;
+
+    _release(this->root);
+    this->root = newRoot;
+
+    return Error();
+}
+
+template <typename T, typename Traits>
+Error BasicPersistentTree<T, Traits>::FromTree(const PointerTree* tree)
+{
+    SoftAssert(tree, ERROR_NULLPTR);
+
+    typedef typename PointerTree::Node TreeNode;
+
+    // copies[depth] is the copy of the last node entered at that depth
+    struct : TreeVisitor
+    {
+        Node*  root;
+        Node** copies;
+        size_t capacity;
+
+        Error Enter(TreeNode* node, size_t depth)
+        {
+            RETURN_ERROR(_grow(&this->copies, &this->capacity, depth + 1));
+
+            Node* copy = (Node*)calloc(1, sizeof(*copy));
+            if (!copy)
+                return CREATE_ERROR(ERROR_NO_MEMORY);
+
+            copy->value = node->value;
+            copy->refs.store(1, std::memory_order_relaxed);
+
+            if (depth == 0)
+                this->root = copy;
+            else
+            {
+                if (node->parent->left == node)
+                    this->copies[depth - 1]->left  = copy;
+                else
+                    this->copies[depth - 1]->right = copy;
+            }
+            this->copies[depth] = copy;
+
+            return Error();
+        }
+    } visitor;
+    visitor.root     = nullptr;
+    visitor.copies   = nullptr;
+    visitor.capacity = 0;
+
+    Error error = TreeWalk(tree->root, visitor);
+    free(visitor.copies);
+
+    // a broken copy is still a whole tree, it goes the same way as a finished one
+    if (error)
+    {
+        _release(visitor.root);
+        return error;
+    }
+
+    _release(this->root);
+    this->root = visitor.root;
+
+    return Error();
+}
+
+template <typename T, typename Traits>
+Error BasicPersistentTree<T, Traits>::ToTree(PointerTree* tree) const
+{
+    SoftAssert(tree, ERROR_NULLPTR);
+
+    typedef typename PointerTree::Node TreeNode;
+    typedef typename PointerTree::Pool Pool;
+
+    if (!this->root)
+        return CREATE_ERROR(ERROR_NO_ROOT);
+
+    /** @struct Pending
+     * @brief Node to copy under parent, there are no parent links to climb back
+     */
+    struct Pending
+    {
+        const Node* node;
+        TreeNode*   parent;
+        bool        isLeft;
+    };
+
+    Pool* pool = (Pool*)calloc(1, sizeof(*pool));
+    if (!pool)
+        return CREATE_ERROR(ERROR_NO_MEMORY);
+    pool->Init();
+
+    Pending*  stack     = nullptr;
+    size_t    capacity  = 0;
+    size_t    stackSize = 0;
+    TreeNode* root      = nullptr;
+
+    Error error = _grow(&stack, &capacity, 1);
+    if (!error)
+        stack[stackSize++] = { this->root, nullptr, false };
+
+    while (stackSize && !error)
+    {
+        Pending top = stack[--stackSize];
+
+        typename TreeNode::Result nodeRes = TreeNode::New(top.node->value, nullptr, nullptr, pool);
+        error = nodeRes.error;
+        if (error)
+            break;
+
+        TreeNode* node = nodeRes.value;
+
+        // sizes of inner nodes are recounted when asked for
+        #ifdef TREE_SUBTREE_SIZES
+        if (top.node->left || top.node->right)
+            node->nodeCount = TREE_SIZE_STALE;
+        #endif
+
+        if (!top.parent)
+            root = node;
+        else if (top.isLeft)
+            top.parent->left  = node;
+        else
+            top.parent->right = node;
+        node->parent = top.parent;
+
+        error = _grow(&stack, &capacity, stackSize + 2);
+        if (error)
+            break;
+
+        if (top.node->right)
+            stack[stackSize++] = { top.node->right, node, false };
+        if (top.node->left)
+            stack[stackSize++] = { top.node->left,  node, true };
+    }
+
+    free(stack);
+
+    if (error)
+    {
+        pool->Destructor();
+        free(pool);
+        return error;
+    }
+
+    tree->root = root;
+    tree->pool = pool;
+
+    return Error();
+}
+
+/**
+ * @brief Checks that path is made of 'L' and 'R' and gives its length
+ */
+template <typename Node>
+static Error _checkPath(const char* path, size_t* length)
+{
+    SoftAssert(path, ERROR_NULLPTR);
+
+    size_t steps = strspn(path, "LR");
+    if (path[steps] != '\0')
+        return CREATE_ERROR(ERROR_SYNTAX);
+
+    *length = steps;
+
+    return Error();
+}
+
+/**
+ * @brief The node steps steps down path from node, nullptr if one is missing
+ */
+template <typename Node>
+static Node* _follow(Node* node, const char* path, size_t steps)
+{
+    for (size_t step = 0; step < steps && node; step++)
+        node = path[step] == 'R' ? node->right : node->left;
+
+    return node;
+}
+
+/**
+ * @brief Copies the nodes from root down steps steps of path, the copies point
+ * to the old subtrees off the way
+ *
+ * The last node may be missing, then its copy is a new leaf. All copies are
+ * allocated first, so nothing changes if memory runs out.
+ */
+template <typename Node>
+static Error _copyPath(Node* root, const char* path, size_t steps, Node** newRoot, Node** last)
+{
+    Node** copies = (Node**)calloc(steps + 1, sizeof(*copies));
+    if (!copies)
+        return CREATE_ERROR(ERROR_NO_MEMORY);
+
+    for (size_t depth = 0; depth <= steps; depth++)
+    {
+        copies[depth] = (Node*)calloc(1, sizeof(*copies[depth]));
+        if (copies[depth])
+            continue;
+
+        for (size_t copy = 0; copy < depth; copy++)
+            free(copies[copy]);
+        free(copies);
+
+        return CREATE_ERROR(ERROR_NO_MEMORY);
+    }
+
+    Node*  old  = root;
+    Node** link = newRoot;
+
+    for (size_t depth = 0; depth <= steps; depth++)
+    {
+        Node* copy = copies[depth];
+        copy->refs.store(1, std::memory_order_relaxed);
+        *link = copy;
+
+        if (!old)
+            break;
+
+        copy->value = old->value;
+        copy->left  = old->left;
+        copy->right = old->right;
+
+        if (depth == steps)
+        {
+            _retain(copy->left);
+            _retain(copy->right);
+            break;
+        }
+
+        // the child on the way gets its own copy, the other one gets one more parent
+        bool goRight = path[depth] == 'R';
+        _retain(goRight ? copy->left : copy->right);
+
+        link = goRight ? &copy->right : &copy->left;
+        old  = goRight ? old->right   : old->left;
+    }
+
+    *last = copies[steps];
+    free(copies);
+
+    return Error();
+}
+
+template <typename Node>
+static void _retain(Node* node)
+{
+    if (node)
+        node->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Drops one reference to node and frees the nodes nobody holds anymore
+ *
+ * A dying left child is rotated up over its parent, so dying nodes still to
+ * free hang to the right of the current one and no stack is needed. Right
+ * children waiting there have no references left, an old right child has some.
+ */
+template <typename Node>
+static void _release(Node* node)
+{
+    if (!node || node->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    while (node)
+    {
+        Node* left = node->left;
+        if (left)
+        {
+            node->left = nullptr;
+
+            if (left->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                node->left  = left->right;
+                left->right = node;
+                node        = left;
+            }
+
+            continue;
+        }
+
+        Node* right = node->right;
+        free(node);
+
+        if (right && right->refs.load(std::memory_order_acquire) != 0 &&
+            right->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            right = nullptr;
+
+        node = right;
+    }
+}
+
+/**
+ * @brief Makes room for size elements, at least doubling the array
+ */
+template <typename T>
+static Error _grow(T** array, size_t* capacity, size_t size)
+{
+    if (size <= *capacity)
+        return Error();
+
+    size_t newCapacity = *capacity ? 2 * *capacity : 64;
+    while (newCapacity < size)
+        newCapacity *= 2;
+
+    T* newArray = (T*)realloc(*array, newCapacity * sizeof(**array));
+    if (!newArray)
+        return CREATE_ERROR(ERROR_NO_MEMORY);
+
+    *array    = newArray;
+    *capacity = newCapacity;
+
+    return Error();
+}
+
+#define INSTANTIATE_PERSISTENT(T) template struct BasicPersistentTree<T>;
+TREE_ELEMENT_TYPES(INSTANTIATE_PERSISTENT)
+#undef INSTANTIATE_PERSISTENT
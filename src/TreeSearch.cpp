@@ -0,0 +1,534 @@
+#include <stdlib.h>
+#include "TreeSearch.hpp"
+#include "TreeWalk.hpp"
+
+template <typename Tree>
+static void _rotateLeft(Tree* tree, typename Tree::Node* node);
+
+template <typename Tree>
+static void _rotateRight(Tree* tree, typename Tree::Node* node);
+
+template <typename Tree>
+static void _replace(Tree* tree, typename Tree::Node* node, typename Tree::Node* with);
+
+template <typename Tree>
+static void _insertFixup(Tree* tree, typename Tree::Node* node);
+
+template <typename Tree>
+static void _eraseFixup(Tree* tree, typename Tree::Node* node, typename Tree::Node* parent);
+
+template <typename T, typename Traits>
+Error BasicSearchTree<T, Traits>::Init()
+{
+    this->root = nullptr;
+    this->size = 0;
+
+    this->pool = (Pool*)calloc(1, sizeof(*this->pool));
+    if (!this->pool)
+        return CREATE_ERROR(ERROR_NO_MEMORY);
+
+    return this->pool->Init();
+}
+
+template <typename T, typename Traits>
+Error BasicSearchTree<T, Traits>::Destructor()
+{
+    if (this->pool)
+    {
+        this->pool->Destructor();
+        free(this->pool);
+    }
+
+    this->root = nullptr;
+    this->pool = nullptr;
+    this->size = 0;
+
+    return Error();
+}
+
+template <typename T, typename Traits>
+typename BasicSearchTree<T, Traits>::Node::Result BasicSearchTree<T, Traits>::Insert(T value)
+{
+    SoftAssertResult(this->pool, nullptr, ERROR_NULLPTR);
+
+    Node*  parent = nullptr;
+    Node** link   = &this->root;
+
+    while (*link)
+    {
+        parent = *link;
+
+        if (value < parent->value)
+            link = &parent->left;
+        else if (parent->value < value)
+            link = &parent->right;
+        else
+            return { parent, Error() };
+    }
+
+    typename Node::Result nodeRes = Node::New(value, nullptr, nullptr, this->pool);
+    RETURN_RESULT(nodeRes);
+
+    Node* node = nodeRes.value;
+
+    node->parent = parent;
+    node->red    = 1;
+    *link        = node;
+    this->size++;
+
+    #ifdef TREE_SUBTREE_SIZES
+    if (parent)
+    {
+        Error error = parent->InvalidateSizes();
+        if (error)
+            return { nullptr, error };
+    }
+    #endif
+
+    _insertFixup(this, node);
+
+    return { node, Error() };
+}
+
+template <typename T, typename Traits>
+typename BasicSearchTree<T, Traits>::Node* BasicSearchTree<T, Traits>::Find(T value) const
+{
+    Node* node = this->root;
+
+    while (node)
+    {
+        if (value < node->value)
+            node = node->left;
+        else if (node->value < value)
+            node = node->right;
+        else
+            return node;
+    }
+
+    return nullptr;
+}
+
+template <typename T, typename Traits>
+typename BasicSearchTree<T, Traits>::Node* BasicSearchTree<T, Traits>::LowerBound(T value) const
+{
+    Node* found = nullptr;
+    Node* node  = this->root;
+
+    while (node)
+    {
+        if (node->value < value)
+            node = node->right;
+        else
+        {
+            found = node;
+            node  = node->left;
+        }
+    }
+
+    return found;
+}
+
+template <typename T, typename Traits>
+TreeNodeCountResult BasicSearchTree<T, Traits>::Erase(T value)
+{
+    Node* node = this->Find(value);
+    if (!node)
+        return { 0, Error() };
+
+    // child takes the place of the node which leaves its spot, parent is its new parent
+    Node* child      = nullptr;
+    Node* parent     = nullptr;
+    bool  removedRed = node->red;
+
+    if (!node->left || !node->right)
+    {
+        child  = node->left ? node->left : node->right;
+        parent = node->parent;
+
+        _replace(this, node, child);
+    }
+    else
+    {
+        // the successor has no left child, it moves to the place of the node
+        Node* successor = node->right;
+        while (successor->left)
+            successor = successor->left;
+
+        removedRed = successor->red;
+        child      = successor->right;
+
+        if (successor->parent == node)
+            parent = successor;
+        else
+        {
+            parent = successor->parent;
+            _replace(this, successor, child);
+
+            successor->right         = node->right;
+            successor->right->parent = successor;
+        }
+
+        _replace(this, node, successor);
+
+        successor->left         = node->left;
+        successor->left->parent = successor;
+        successor->red          = node->red;
+
+        #ifdef TREE_SUBTREE_SIZES
+        Error error = successor->InvalidateSizes();
+        if (error)
+            return { 0, error };
+        #endif
+    }
+
+    #ifdef TREE_SUBTREE_SIZES
+    if (parent)
+    {
+        Error error = parent->InvalidateSizes();
+        if (error)
+            return { 0, error };
+    }
+    #endif
+
+    if (!removedRed)
+        _eraseFixup(this, child, parent);
+
+    this->size--;
+
+    node->value  = Traits::POISON;
+    node->left   = nullptr;
+    node->right  = nullptr;
+    node->parent = nullptr;
+    Error error = Pool::Free(node);
+    if (error)
+        return { 0, error };
+
+    return { 1, Error() };
+}
+
+template <typename T, typename Traits>
+typename BasicSearchTree<T, Traits>::Node* BasicSearchTree<T, Traits>::First() const
+{
+    Node* node = this->root;
+    if (!node)
+        return nullptr;
+
+    while (node->left)
+        node = node->left;
+
+    return node;
+}
+
+template <typename T, typename Traits>
+typename BasicSearchTree<T, Traits>::Node* BasicSearchTree<T, Traits>::Next(Node* node)
+{
+    if (!node)
+        return nullptr;
+
+    if (node->right)
+    {
+        node = node->right;
+        while (node->left)
+            node = node->left;
+
+        return node;
+    }
+
+    while (node->parent && node->parent->right == node)
+        node = node->parent;
+
+    return node->parent;
+}
+
+template <typename T, typename Traits>
+Error BasicSearchTree<T, Traits>::Verify() const
+{
+    if (!this->root)
+        return this->size == 0 ? Error() : CREATE_ERROR(ERROR_BAD_TREE);
+
+    if (this->root->parent)
+        return CREATE_ERROR(ERROR_TREE_LOOP);
+    if (this->root->red)
+        return CREATE_ERROR(ERROR_BAD_TREE);
+
+    // every way down to a missing child must meet the same number of black nodes
+    struct : TreeVisitor
+    {
+        Node*  previous;
+        size_t count;
+        size_t blackDepth;
+        size_t leafBlackDepth;
+
+        Error Enter(Node* node, size_t)
+        {
+            if (node->red && node->parent && node->parent->red)
+                return CREATE_ERROR(ERROR_BAD_TREE);
+
+            if (!node->red)
+                this->blackDepth++;
+
+            if (!node->left || !node->right)
+            {
+                if (this->leafBlackDepth == 0)
+                    this->leafBlackDepth = this->blackDepth;
+                else if (this->leafBlackDepth != this->blackDepth)
+                    return CREATE_ERROR(ERROR_BAD_TREE);
+            }
+
+            return Error();
+        }
+
+        Error Between(Node* node, size_t)
+        {
+            if (this->previous && !(this->previous->value < node->value))
+                return CREATE_ERROR(ERROR_BAD_TREE);
+
+            this->previous = node;
+            this->count++;
+
+            return Error();
+        }
+
+        Error Leave(Node* node, size_t)
+        {
+            if (!node->red)
+                this->blackDepth--;
+
+            return Error();
+        }
+    } visitor;
+    visitor.previous       = nullptr;
+    visitor.count          = 0;
+    visitor.blackDepth     = 0;
+    visitor.leafBlackDepth = 0;
+
+    RETURN_ERROR(TreeWalk(this->root, visitor));
+
+    if (visitor.count != this->size)
+        return CREATE_ERROR(ERROR_BAD_TREE);
+
+    return Error();
+}
+
+/**
+ * @brief Puts with in the place of node under node's parent, with may be nullptr
+ */
+template <typename Tree>
+static void _replace(Tree* tree, typename Tree::Node* node, typename Tree::Node* with)
+{
+    typename Tree::Node* parent = node->parent;
+
+    if (!parent)
+        tree->root = with;
+    else if (parent->left == node)
+        parent->left = with;
+    else
+        parent->right = with;
+
+    if (with)
+        with->parent = parent;
+}
+
+/**
+ * @brief Lifts the right child of node to its place
+ *
+ * Both nodes become stale, their ancestors already are as they lie on the changed path.
+ */
+template <typename Tree>
+static void _rotateLeft(Tree* tree, typename Tree::Node* node)
+{
+    typename Tree::Node* right = node->right;
+
+    node->right = right->left;
+    if (right->left)
+        right->left->parent = node;
+
+    _replace(tree, node, right);
+
+    right->left  = node;
+    node->parent = right;
+
+    #ifdef TREE_SUBTREE_SIZES
+    node->nodeCount  = TREE_SIZE_STALE;
+    right->nodeCount = TREE_SIZE_STALE;
+    #endif
+}
+
+/**
+ * @brief Lifts the left child of node to its place, mirrors @ref _rotateLeft
+ */
+template <typename Tree>
+static void _rotateRight(Tree* tree, typename Tree::Node* node)
+{
+    typename Tree::Node* left = node->left;
+
+    node->left = left->right;
+    if (left->right)
+        left->right->parent = node;
+
+    _replace(tree, node, left);
+
+    left->right  = node;
+    node->parent = left;
+
+    #ifdef TREE_SUBTREE_SIZES
+    node->nodeCount = TREE_SIZE_STALE;
+    left->nodeCount = TREE_SIZE_STALE;
+    #endif
+}
+
+/**
+ * @brief Restores the colors after a red node was added
+ */
+template <typename Tree>
+static void _insertFixup(Tree* tree, typename Tree::Node* node)
+{
+    typedef typename Tree::Node Node;
+
+    Node* parent = nullptr;
+    while ((parent = node->parent) && parent->red)
+    {
+        // a red node is never the root, so the grandparent is there
+        Node* grand = parent->parent;
+
+        if (parent == grand->left)
+        {
+            Node* uncle = grand->right;
+            if (uncle && uncle->red)
+            {
+                parent->red = 0;
+                uncle->red  = 0;
+                grand->red  = 1;
+                node        = grand;
+                continue;
+            }
+
+            if (node == parent->right)
+            {
+                _rotateLeft(tree, parent);
+                node   = parent;
+                parent = node->parent;
+            }
+
+            parent->red = 0;
+            grand->red  = 1;
+            _rotateRight(tree, grand);
+        }
+        else
+        {
+            Node* uncle = grand->left;
+            if (uncle && uncle->red)
+            {
+                parent->red = 0;
+                uncle->red  = 0;
+                grand->red  = 1;
+                node        = grand;
+                continue;
+            }
+
+            if (node == parent->left)
+            {
+                _rotateRight(tree, parent);
+                node   = parent;
+                parent = node->parent;
+            }
+
+            parent->red = 0;
+            grand->red  = 1;
+            _rotateLeft(tree, grand);
+        }
+    }
+
+    tree->root->red = 0;
+}
+
+/**
+ * @brief Restores the colors after a black node left, node took its place under parent
+ *
+ * node may be nullptr, then parent tells where it is. The other child of parent
+ * is never missing, as the way through it had one more black node.
+ */
+template <typename Tree>
+static void _eraseFixup(Tree* tree, typename Tree::Node* node, typename Tree::Node* parent)
+{
+    typedef typename Tree::Node Node;
+
+    while (node != tree->root && (!node || !node->red))
+    {
+        if (node == parent->left)
+        {
+            Node* sibling = parent->right;
+            if (sibling->red)
+            {
+                sibling->red = 0;
+                parent->red  = 1;
+                _rotateLeft(tree, parent);
+                sibling = parent->right;
+            }
+
+            if ((!sibling->left || !sibling->left->red) && (!sibling->right || !sibling->right->red))
+            {
+                sibling->red = 1;
+                node         = parent;
+                parent       = node->parent;
+                continue;
+            }
+
+            if (!sibling->right || !sibling->right->red)
+            {
+                sibling->left->red = 0;
+                sibling->red       = 1;
+                _rotateRight(tree, sibling);
+                sibling = parent->right;
+            }
+
+            sibling->red = parent->red;
+            parent->red  = 0;
+            if (sibling->right)
+                sibling->right->red = 0;
+            _rotateLeft(tree, parent);
+        }
+        else
+        {
+            Node* sibling = parent->left;
+            if (sibling->red)
+            {
+                sibling->red = 0;
+                parent->red  = 1;
+                _rotateRight(tree, parent);
+                sibling = parent->left;
+            }
+
+            if ((!sibling->left || !sibling->left->red) && (!sibling->right || !sibling->right->red))
+            {
+                sibling->red = 1;
+                node         = parent;
+                parent       = node->parent;
+                continue;
+            }
+
+            if (!sibling->left || !sibling->left->red)
+            {
+                sibling->right->red = 0;
+                sibling->red        = 1;
+                _rotateLeft(tree, sibling);
+                sibling = parent->left;
+            }
+
+            sibling->red = parent->red;
+            parent->red  = 0;
+            if (sibling->left)
+                sibling->left->red = 0;
+            _rotateRight(tree, parent);
+        }
+
+        node = tree->root;
+    }
+
+    if (node)
+        node->red = 0;
+}
+
+#define INSTANTIATE_SEARCH(T) template struct BasicSearchTree<T>;
+TREE_ELEMENT_TYPES(INSTANTIATE_SEARCH)
+#undef INSTANTIATE_SEARCH
@@ -0,0 +1,56 @@
+#include "TreeStats.hpp"
+
+TreeStatsCounters TREE_STATS_COUNTERS[TREE_STATS_OPERATIONS_COUNT] = {};
+
+static const char* OPERATION_NAMES[TREE_STATS_OPERATIONS_COUNT] =
+{
+    "verify",
+    "verify full",
+    "invalidate sizes",
+    "update sizes",
+    "count nodes",
+    "read",
+    "read binary",
+    "print",
+    "write binary",
+    "dump",
+    "render",
+    "allocate slab",
+};
+
+const char* TreeStats::OperationName(TreeStatsOperation operation)
+{
+    if (operation < 0 || operation >= TREE_STATS_OPERATIONS_COUNT)
+        return "unknown";
+
+    return OPERATION_NAMES[operation];
+}
+
+Error TreeStats::WriteHtml(FILE* htmlFile) const
+{
+    SoftAssert(htmlFile, ERROR_NULLPTR);
+
+    fprintf(htmlFile,
+    "<h1>Stats</h1>\n"
+    "<table>\n"
+    "<tr><th>Operation</th><th>Calls</th><th>Cycles</th><th>Cycles/call</th><th>Nodes</th><th>Bytes</th></tr>\n");
+
+    for (size_t operation = 0; operation < TREE_STATS_OPERATIONS_COUNT; operation++)
+    {
+        const TreeOperationStats* stats = &this->operations[operation];
+        if (!stats->calls && !stats->nodes && !stats->bytes)
+            continue;
+
+        fprintf(htmlFile, "<tr><td>%s</td><td>%llu</td><td>%llu</td><td>%llu</td><td>%llu</td><td>%llu</td></tr>\n",
+                OPERATION_NAMES[operation],
+                (unsigned long long)stats->calls,
+                (unsigned long long)stats->cycles,
+                (unsigned long long)(stats->calls ? stats->cycles / stats->calls : 0),
+                (unsigned long long)stats->nodes,
+                (unsigned long long)stats->bytes);
+    }
+
+    fprintf(htmlFile, "</table>\n");
+
+    return Error();
+}
@@ -0,0 +1,299 @@
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <charconv>
+#include "TreeText.hpp"
+#include "TreeStats.hpp"
+
+static const size_t   MAX_EXACT_DIGITS   = 19;
+static const uint64_t MAX_EXACT_MANTISSA = (uint64_t)1 << 53;
+static const int      MAX_EXACT_EXP10    = 22;
+static const int      MAX_EXP10          = 100000;
+
+static const double POW10[MAX_EXACT_EXP10 + 1] =
+{
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static TreeToken _trim(const char* begin, const char* end);
+
+Error TreeTextReader::Init(FILE* file)
+{
+    SoftAssert(file, ERROR_NULLPTR);
+
+    this->file   = file;
+    this->buffer = (char*)calloc(TREE_READ_CHUNK_SIZE, 1);
+    this->size   = 0;
+    this->pos    = 0;
+    this->eof    = false;
+
+    if (!this->buffer)
+        return CREATE_ERROR(ERROR_NO_MEMORY);
+
+    return Error();
+}
+
+Error TreeTextReader::Destructor()
+{
+    free(this->buffer);
+
+    this->file   = nullptr;
+    this->buffer = nullptr;
+    this->size   = 0;
+    this->pos    = 0;
+
+    return Error();
+}
+
+TreeTokenResult TreeTextReader::NextToken()
+{
+    size_t separatorLength = strlen(TREE_WORD_SEPARATOR);
+
+    while (true)
+    {
+        const char* begin     = this->buffer + this->pos;
+        const char* end       = this->buffer + this->size;
+        const char* separator = (const char*)memmem(begin, (size_t)(end - begin),
+                                                    TREE_WORD_SEPARATOR, separatorLength);
+
+        if (separator || (this->eof && begin != end))
+        {
+            if (!separator)
+                separator = end;
+
+            this->pos = (size_t)(separator - this->buffer);
+            if (separator != end)
+                this->pos += separatorLength;
+
+            TreeToken token = _trim(begin, separator);
+            if (token.length)
+                return { token, Error() };
+            continue;
+        }
+
+        if (this->eof)
+            return { { nullptr, 0 }, Error() };
+
+        // the word goes on in the next chunk, move its start to the front
+        size_t left = this->size - this->pos;
+        if (left == TREE_READ_CHUNK_SIZE)
+            return { { nullptr, 0 }, CREATE_ERROR(ERROR_SYNTAX) };
+
+        memmove(this->buffer, this->buffer + this->pos, left);
+        this->size = left;
+        this->pos  = 0;
+
+        size_t readBytes = fread(this->buffer + this->size, 1, TREE_READ_CHUNK_SIZE - this->size, this->file);
+        this->size += readBytes;
+        TreeStatsAdd(TREE_STATS_READ, 0, readBytes);
+
+        if (readBytes == 0)
+        {
+            if (ferror(this->file))
+                return { { nullptr, 0 }, CREATE_ERROR(ERROR_BAD_FILE) };
+            this->eof = true;
+        }
+    }
+}
+
+static TreeToken _trim(const char* begin, const char* end)
+{
+    while (begin < end && isspace((unsigned char)*begin))
+        begin++;
+    while (end > begin && isspace((unsigned char)end[-1]))
+        end--;
+
+    return { begin, (size_t)(end - begin) };
+}
+
+bool TreeParseDouble(TreeToken token, double* value)
+{
+    if (!value)
+        return false;
+
+    const char* cur = token.begin;
+    const char* end = token.begin + token.length;
+
+    bool negative = false;
+    if (cur < end && (*cur == '-' || *cur == '+'))
+        negative = *cur++ == '-';
+
+    const char* unsignedBegin = cur;
+
+    size_t rest = (size_t)(end - cur);
+    if ((rest == 3 || rest == 8) && strncasecmp(cur, "infinity", rest) == 0)
+    {
+        *value = negative ? -INFINITY : INFINITY;
+        return true;
+    }
+    if (rest == 3 && strncasecmp(cur, "nan", rest) == 0)
+    {
+        *value = negative ? -NAN : NAN;
+        return true;
+    }
+
+    uint64_t mantissa  = 0;
+    size_t   digits    = 0;
+    int      exp10     = 0;
+    bool     anyDigit  = false;
+    bool     truncated = false;
+
+    for (; cur < end && isdigit((unsigned char)*cur); cur++)
+    {
+        anyDigit = true;
+        if (digits < MAX_EXACT_DIGITS)
+        {
+            mantissa = mantissa * 10 + (uint64_t)(*cur - '0');
+            digits  += mantissa != 0;
+        }
+        else
+        {
+            exp10++;
+            truncated = true;
+        }
+    }
+
+    if (cur < end && *cur == '.')
+    {
+        for (cur++; cur < end && isdigit((unsigned char)*cur); cur++)
+        {
+            anyDigit = true;
+            if (digits < MAX_EXACT_DIGITS)
+            {
+                mantissa = mantissa * 10 + (uint64_t)(*cur - '0');
+                digits  += mantissa != 0;
+                exp10--;
+            }
+            else
+                truncated = true;
+        }
+    }
+
+    if (!anyDigit)
+        return false;
+
+    if (cur < end && (*cur == 'e' || *cur == 'E'))
+    {
+        cur++;
+
+        bool negativeExp = false;
+        if (cur < end && (*cur == '-' || *cur == '+'))
+            negativeExp = *cur++ == '-';
+
+        if (cur == end || !isdigit((unsigned char)*cur))
+            return false;
+
+        int exponent = 0;
+        for (; cur < end && isdigit((unsigned char)*cur); cur++)
+            if (exponent < MAX_EXP10)
+                exponent = exponent * 10 + (*cur - '0');
+
+        exp10 += negativeExp ? -exponent : exponent;
+    }
+
+    if (cur != end)
+        return false;
+
+    if (!truncated && mantissa <= MAX_EXACT_MANTISSA && -MAX_EXACT_EXP10 <= exp10 && exp10 <= MAX_EXACT_EXP10)
+    {
+        double number = (double)mantissa;
+        number = exp10 < 0 ? number / POW10[-exp10] : number * POW10[exp10];
+
+        *value = negative ? -number : number;
+        return true;
+    }
+
+    // the syntax is checked above, from_chars rounds correctly and ignores the locale
+    double number = 0;
+    std::from_chars_result result = std::from_chars(unsignedBegin, end, number);
+
+    if (result.ec == std::errc::result_out_of_range)
+        number = exp10 > 0 ? INFINITY : 0;
+    else if (result.ec != std::errc() || result.ptr != end)
+        return false;
+
+    *value = negative ? -number : number;
+    return true;
+}
+
+Error TreeTextWriter::Init(int fd)
+{
+    this->fd       = fd;
+    this->buffer   = (char*)calloc(TREE_WRITE_BUFFER_SIZE, 1);
+    this->size     = 0;
+    this->capacity = TREE_WRITE_BUFFER_SIZE;
+
+    if (!this->buffer)
+    {
+        this->capacity = 0;
+        return CREATE_ERROR(ERROR_NO_MEMORY);
+    }
+
+    return Error();
+}
+
+Error TreeTextWriter::Destructor()
+{
+    free(this->buffer);
+
+    this->fd       = -1;
+    this->buffer   = nullptr;
+    this->size     = 0;
+    this->capacity = 0;
+
+    return Error();
+}
+
+Error TreeTextWriter::Flush()
+{
+    if (this->fd < 0)
+        return Error();
+
+    size_t written = 0;
+    while (written < this->size)
+    {
+        ssize_t result = write(this->fd, this->buffer + written, this->size - written);
+        if (result < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return CREATE_ERROR(ERROR_BAD_FILE);
+        }
+        written += (size_t)result;
+    }
+
+    this->size = 0;
+
+    return Error();
+}
+
+Error TreeTextWriter::Reserve(size_t length)
+{
+    if (this->size + length <= this->capacity)
+        return Error();
+
+    if (this->fd >= 0)
+    {
+        RETURN_ERROR(this->Flush());
+        if (length <= this->capacity)
+            return Error();
+    }
+
+    size_t newCapacity = this->capacity ? this->capacity : TREE_WRITE_BUFFER_SIZE;
+    while (newCapacity < this->size + length)
+        newCapacity *= 2;
+
+    char* newBuffer = (char*)realloc(this->buffer, newCapacity);
+    if (!newBuffer)
+        return CREATE_ERROR(ERROR_NO_MEMORY);
+
+    this->buffer   = newBuffer;
+    this->capacity = newCapacity;
+
+    return Error();
+}